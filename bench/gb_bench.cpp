@@ -0,0 +1,160 @@
+#include "cpu.hpp"
+#include "perf_counters.hpp"
+
+#include <chrono>
+
+// Headless ROM throughput: emulated MHz, frames/s, instructions/s and host ns per frame,
+// plus host counters per guest instruction read around every frame where perf_event_open works
+auto main(int argc, char *argv[]) -> int
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: gb_bench ROM [frames] [--json FILE] [--debug-port ADDR] [--frame-format FORMAT]" << endl;
+        return 1;
+    }
+
+    string rom_path = argv[1];
+    u32 frames = 600;
+    string json_path;
+    unique_ptr<DebugPort> debug_port;
+    string frame_format = "rgb";
+    for (int i = 2; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc)
+        {
+            json_path = argv[++i];
+        }
+        else if (arg == "--debug-port" && i + 1 < argc)
+        {
+            debug_port = make_unique<DebugPort>(DebugPort::parse_address(argv[++i]));
+        }
+        else if (arg == "--frame-format" && i + 1 < argc)
+        {
+            frame_format = argv[++i];
+        }
+        else
+        {
+            frames = static_cast<u32>(stoul(arg));
+        }
+    }
+
+    Cartridge cart;
+    cart.load(rom_path);
+    MemoryBus bus(&cart);
+    FlagsRegister flags;
+    Registers regs(&bus, &flags);
+    Instruction inst(&regs);
+    PPU ppu(&bus, &regs, true);
+    ppu.set_frame_format(PPU::parse_frame_format(frame_format));
+    CPU cpu(&regs, &inst, &ppu);
+    cpu.set_debug_port(debug_port.get());
+    cpu.start_cartridge();
+
+    PerfCounters counters;
+    PerfSample perf;
+    u64 worst_frame_cycles = 0;
+    u32 worst_frame = 0;
+    u32 frame = ppu.get_frame_count();
+
+    // A ROM may end the run early through the debug port
+    auto start = chrono::steady_clock::now();
+    counters.start();
+    while (ppu.get_frame_count() < frames && !(debug_port && debug_port->is_stop_requested()))
+    {
+        cpu.step();
+        if (counters.available() && ppu.get_frame_count() != frame)
+        {
+            PerfSample sample = counters.stop();
+            perf += sample;
+            if (sample.cycles > worst_frame_cycles)
+            {
+                worst_frame_cycles = sample.cycles;
+                worst_frame = frame;
+            }
+            frame = ppu.get_frame_count();
+            counters.start();
+        }
+    }
+    perf += counters.stop(); // Whatever ran after the last frame
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    frames = ppu.get_frame_count();
+
+    // The DMG clock is 4.194304 MHz in T-cycles, 4 per M-cycle
+    double emulated_mhz = static_cast<double>(cpu.get_cycles()) * 4 / seconds / 1e6;
+    double fps = frames / seconds;
+    double ips = static_cast<double>(cpu.get_instructions()) / seconds;
+    double ns_per_frame = frames ? seconds * 1e9 / frames : 0.0;
+    double speed = emulated_mhz / 4.194304;
+
+    // Untimed, converts the last frame back from the stored format so every format can be checked against rgb
+    u64 frame_hash = 0xCBF29CE484222325; // FNV-1a
+    for (const Colour &pixel : ppu.capture_frame())
+    {
+        for (u8 channel : {pixel.r, pixel.g, pixel.b})
+        {
+            frame_hash = (frame_hash ^ channel) * 0x100000001B3;
+        }
+    }
+
+    cout << "rom: " << rom_path << endl;
+    cout << "frames: " << frames << ", M-cycles: " << cpu.get_cycles() << ", instructions: " << cpu.get_instructions() << endl;
+    cout << "time: " << seconds << " s" << endl;
+    cout << "emulated clock: " << emulated_mhz << " MHz (" << speed << "x real time)" << endl;
+    cout << "frames/s: " << fps << endl;
+    cout << "instructions/s: " << ips << endl;
+    cout << "host ns/frame: " << ns_per_frame << endl;
+    cout << "frame format: " << frame_format << ", last frame hash: " << hex << frame_hash << dec << endl;
+    counters.report(cout, perf, cpu.get_instructions());
+    if (counters.available())
+    {
+        cout << "worst frame: " << worst_frame << ", " << worst_frame_cycles << " host cycles" << endl;
+    }
+#ifdef OPCODE_STATS
+    cpu.get_opcode_stats().report(cout);
+#endif
+    if (debug_port)
+    {
+        debug_port->report(cout);
+    }
+
+    if (!json_path.empty())
+    {
+        ofstream json(json_path, ios::trunc);
+        if (!json.is_open())
+        {
+            throw runtime_error("Failed to open '" + json_path + "'");
+        }
+
+        string escaped;
+        for (char c : rom_path)
+        {
+            if (c == '"' || c == '\\')
+            {
+                escaped.push_back('\\');
+            }
+            escaped.push_back(c);
+        }
+
+        json << "{\"rom\": \"" << escaped << "\", \"frames\": " << frames
+             << ", \"m_cycles\": " << cpu.get_cycles() << ", \"instructions\": " << cpu.get_instructions()
+             << ", \"seconds\": " << seconds << ", \"emulated_mhz\": " << emulated_mhz << ", \"speed\": " << speed
+             << ", \"fps\": " << fps << ", \"instructions_per_second\": " << ips
+             << ", \"ns_per_frame\": " << ns_per_frame;
+        if (counters.available())
+        {
+            json << ", \"host_cycles\": " << perf.cycles << ", \"host_instructions\": " << perf.instructions;
+            if (counters.has_branch_misses())
+            {
+                json << ", \"branch_misses\": " << perf.branch_misses;
+            }
+            if (counters.has_l1d_misses())
+            {
+                json << ", \"l1d_misses\": " << perf.l1d_misses;
+            }
+        }
+        json << "}" << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "cpu.hpp"
+#include "guest_kernels.hpp"
+#include "perf_counters.hpp"
+
+#include <chrono>
+#include <iomanip>
+
+// Synthetic guest programs run headlessly for a fixed budget of emulated M-cycles each
+auto main(int argc, char *argv[]) -> int
+{
+    u64 budget = (argc > 1) ? stoull(argv[1]) : 20'000'000;
+    string only = (argc > 2) ? argv[2] : "";
+
+    // Host counters per guest instruction, misses per 1000
+    PerfCounters counters;
+    if (!counters.available())
+    {
+        cout << "(hardware counters unavailable, time only)" << endl;
+    }
+    cout << "kernel    M-cycles     instructions  host ms   M-cycles/ns  speed";
+    if (counters.available())
+    {
+        cout << "     cyc/inst  inst/inst " << (counters.has_branch_misses() ? "br-miss/k " : "")
+             << (counters.has_l1d_misses() ? "l1d-miss/k" : "");
+    }
+    cout << endl;
+    for (const GuestKernel &kernel : GUEST_KERNELS)
+    {
+        if (!only.empty() && only != kernel.name)
+        {
+            continue;
+        }
+
+        Cartridge cart;
+        cart.load_bytes(build_kernel_rom(kernel));
+        MemoryBus bus(&cart);
+        FlagsRegister flags;
+        Registers regs(&bus, &flags);
+        Instruction inst(&regs);
+        PPU ppu(&bus, &regs, true);
+        CPU cpu(&regs, &inst, &ppu);
+        cpu.start_cartridge();
+
+        counters.start();
+        auto start = chrono::steady_clock::now();
+        while (cpu.get_cycles() < budget)
+        {
+            cpu.step();
+        }
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        PerfSample sample = counters.stop();
+
+        // Real hardware runs 1.048576 M-cycles per microsecond
+        double per_ns = static_cast<double>(cpu.get_cycles()) / ns;
+        double speed = per_ns * 1000.0 / 1.048576;
+        ostringstream speed_text;
+        speed_text << speed << "x";
+
+        cout << left << setw(10) << kernel.name << setw(13) << cpu.get_cycles() << setw(14) << cpu.get_instructions()
+             << setw(10) << ns / 1e6 << setw(13) << per_ns;
+        if (!counters.available())
+        {
+            cout << speed_text.str();
+        }
+        else
+        {
+            cout << setw(10) << speed_text.str();
+            double guest = static_cast<double>(max<u64>(cpu.get_instructions(), 1));
+            cout << fixed << setprecision(2) << setw(10) << static_cast<double>(sample.cycles) / guest << setw(10)
+                 << static_cast<double>(sample.instructions) / guest;
+            if (counters.has_branch_misses())
+            {
+                cout << setw(10) << static_cast<double>(sample.branch_misses) * 1000.0 / guest;
+            }
+            if (counters.has_l1d_misses())
+            {
+                cout << static_cast<double>(sample.l1d_misses) * 1000.0 / guest;
+            }
+            cout << defaultfloat << setprecision(6);
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,130 @@
+#ifndef GUEST_KERNELS_HPP
+#define GUEST_KERNELS_HPP
+
+#include "common.hpp"
+#include <algorithm>
+#include <vector>
+
+// Hand-assembled SM83 loops that each stress one part of the core, loaded at KERNEL_BASE and run forever
+struct GuestKernel
+{
+    const char *name;
+    const char *description;
+    vector<u8> code;
+};
+
+constexpr u16 KERNEL_BASE = 0x0150; // Entry jumps here from 0x0100
+constexpr u16 KERNEL_DATA = 0x0200; // 256 bytes of source data in ROM
+
+inline const array<GuestKernel, 6> GUEST_KERNELS = {{
+    {"alu",
+     "8-bit ALU ops on registers",
+     {
+         0xAF,             // 0150 XOR A
+         0x06, 0x00,       // 0151 LD B,0
+         0x0E, 0x00,       // 0153 LD C,0
+         0x80,             // 0155 ADD A,B
+         0x89,             // 0156 ADC A,C
+         0x90,             // 0157 SUB B
+         0xA1,             // 0158 AND C
+         0xB0,             // 0159 OR B
+         0xA8,             // 015A XOR B
+         0x3C,             // 015B INC A
+         0x04,             // 015C INC B
+         0x0D,             // 015D DEC C
+         0x18, 0xF5,       // 015E JR 0155
+     }},
+    {"memcpy",
+     "LD A,(HL+) / LD (DE),A copy of 256 bytes ROM to WRAM",
+     {
+         0x21, 0x00, 0x02, // 0150 LD HL,0200
+         0x11, 0x00, 0xC0, // 0153 LD DE,C000
+         0x06, 0x00,       // 0156 LD B,0
+         0x2A,             // 0158 LD A,(HL+)
+         0x12,             // 0159 LD (DE),A
+         0x13,             // 015A INC DE
+         0x05,             // 015B DEC B
+         0x20, 0xFA,       // 015C JR NZ,0158
+         0x18, 0xF0,       // 015E JR 0150
+     }},
+    {"call",
+     "CALL/RET recursion 16 deep with PUSH/POP per level",
+     {
+         0x31, 0xFE, 0xDF, // 0150 LD SP,DFFE
+         0x3E, 0x10,       // 0153 LD A,16
+         0xCD, 0x5A, 0x01, // 0155 CALL 015A
+         0x18, 0xF6,       // 0158 JR 0150
+         0x3D,             // 015A DEC A
+         0xC8,             // 015B RET Z
+         0xC5,             // 015C PUSH BC
+         0xCD, 0x5A, 0x01, // 015D CALL 015A
+         0xC1,             // 0160 POP BC
+         0xC9,             // 0161 RET
+     }},
+    {"bitops",
+     "CB-prefixed SWAP/BIT/SET/RES/shifts/rotates",
+     {
+         0x3E, 0x5A,       // 0150 LD A,5A
+         0x06, 0x00,       // 0152 LD B,0
+         0xCB, 0x37,       // 0154 SWAP A
+         0xCB, 0x7F,       // 0156 BIT 7,A
+         0xCB, 0xC7,       // 0158 SET 0,A
+         0xCB, 0x87,       // 015A RES 0,A
+         0xCB, 0x11,       // 015C RL C
+         0xCB, 0x38,       // 015E SRL B
+         0xCB, 0x20,       // 0160 SLA B
+         0xCB, 0x09,       // 0162 RRC C
+         0x18, 0xEE,       // 0164 JR 0154
+     }},
+    {"vram",
+     "Tile data uploads with the LCD on, every pass changes the tiles",
+     {
+         0x0E, 0x00,       // 0150 LD C,0
+         0x21, 0x00, 0x80, // 0152 LD HL,8000
+         0x11, 0x00, 0x02, // 0155 LD DE,0200
+         0x06, 0x00,       // 0158 LD B,0
+         0x1A,             // 015A LD A,(DE)
+         0x81,             // 015B ADD A,C
+         0x22,             // 015C LD (HL+),A
+         0x13,             // 015D INC DE
+         0x05,             // 015E DEC B
+         0x20, 0xF9,       // 015F JR NZ,015A
+         0x0C,             // 0161 INC C
+         0x18, 0xEE,       // 0162 JR 0152
+     }},
+    {"dma",
+     "OAM DMA from WRAM as fast as it can be started, one source byte changed per transfer",
+     {
+         0x21, 0x00, 0xC0, // 0150 LD HL,C000
+         0x34,             // 0153 INC (HL)
+         0x2C,             // 0154 INC L
+         0x3E, 0xC0,       // 0155 LD A,C0
+         0xEA, 0x46, 0xFF, // 0157 LD (FF46),A
+         0x18, 0xF7,       // 015A JR 0153
+     }},
+}};
+
+// 32 KB ROM image: entry JP to the kernel, the kernel itself and a byte pattern at KERNEL_DATA
+inline auto build_kernel_rom(const GuestKernel &kernel) -> vector<u8>
+{
+    vector<u8> rom(0x8000, 0x00);
+    rom[0x0100] = 0x00; // NOP
+    rom[0x0101] = 0xC3; // JP KERNEL_BASE
+    rom[0x0102] = KERNEL_BASE & 0xFF;
+    rom[0x0103] = KERNEL_BASE >> 8;
+
+    if (KERNEL_BASE + kernel.code.size() > KERNEL_DATA)
+    {
+        throw runtime_error(string("Kernel '") + kernel.name + "' overlaps its data");
+    }
+    copy(kernel.code.begin(), kernel.code.end(), rom.begin() + KERNEL_BASE);
+
+    for (u16 i = 0; i < 0x100; i++)
+    {
+        rom[KERNEL_DATA + i] = static_cast<u8>(i * 7 + 3);
+    }
+
+    return rom;
+}
+
+#endif // GUEST_KERNELS_HPP
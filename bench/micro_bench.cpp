@@ -0,0 +1,112 @@
+#include "instructions.hpp"
+#include "perf_counters.hpp"
+
+#include <chrono>
+#include <iomanip>
+
+// Cost of each ALU helper and register accessor in isolation, the loop itself is measured as "empty"
+auto main(int argc, char *argv[]) -> int
+{
+    u32 iterations = (argc > 1) ? static_cast<u32>(stoul(argv[1])) : 10'000'000;
+
+    Cartridge cart;
+    MemoryBus bus(&cart);
+    FlagsRegister flags;
+    Registers regs(&bus, &flags);
+    Instruction inst(&regs);
+    PerfCounters counters;
+
+    // Results feed the sink so no call can be dropped
+    volatile u32 sink = 0;
+
+    cout << left << setw(22) << "op" << setw(10) << "ns/op";
+    if (counters.available())
+    {
+        cout << setw(12) << "cycles/op" << setw(12) << "instr/op" << "IPC";
+    }
+    cout << endl;
+
+    auto measure = [&](const char *name, auto &&operation) -> void
+    {
+        u32 accumulator = 0;
+        counters.start();
+        auto start = chrono::steady_clock::now();
+        for (u32 i = 0; i < iterations; i++)
+        {
+            accumulator += operation(i);
+        }
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        PerfSample sample = counters.stop();
+        sink = sink + accumulator;
+
+        cout << setw(22) << name << setw(10) << fixed << setprecision(2) << ns / iterations;
+        if (counters.available())
+        {
+            double cycles = static_cast<double>(sample.cycles) / iterations;
+            double instructions = static_cast<double>(sample.instructions) / iterations;
+            cout << setw(12) << cycles << setw(12) << instructions << instructions / max(cycles, 1e-9);
+        }
+        cout << endl;
+    };
+
+    measure("empty", [](u32 i) -> u32 { return i; });
+
+    // 8-bit ALU, A changes every iteration so flags vary
+    measure("add_inst", [&](u32 i) -> u32 { regs.set_a(static_cast<u8>(i)); return inst.add_inst(static_cast<u8>(i >> 3)); });
+    measure("adc_inst", [&](u32 i) -> u32 { regs.set_a(static_cast<u8>(i)); return inst.adc_inst(static_cast<u8>(i >> 3)); });
+    measure("sub_inst", [&](u32 i) -> u32 { regs.set_a(static_cast<u8>(i)); return inst.sub_inst(static_cast<u8>(i >> 3)); });
+    measure("sbc_inst", [&](u32 i) -> u32 { regs.set_a(static_cast<u8>(i)); return inst.sbc_inst(static_cast<u8>(i >> 3)); });
+    measure("and_inst", [&](u32 i) -> u32 { regs.set_a(static_cast<u8>(i)); return inst.and_inst(static_cast<u8>(i >> 3)); });
+    measure("xor_inst", [&](u32 i) -> u32 { regs.set_a(static_cast<u8>(i)); return inst.xor_inst(static_cast<u8>(i >> 3)); });
+    measure("or_inst", [&](u32 i) -> u32 { regs.set_a(static_cast<u8>(i)); return inst.or_inst(static_cast<u8>(i >> 3)); });
+    measure("cp_inst", [&](u32 i) -> u32 { regs.set_a(static_cast<u8>(i)); inst.cp_inst(static_cast<u8>(i >> 3)); return regs.get_f(); });
+    measure("inc_inst", [&](u32 i) -> u32 { return inst.inc_inst(static_cast<u8>(i)); });
+    measure("dec_inst", [&](u32 i) -> u32 { return inst.dec_inst(static_cast<u8>(i)); });
+    measure("addhl_inst", [&](u32 i) -> u32 { regs.set_HL(static_cast<u16>(i)); return inst.addhl_inst(static_cast<u16>(i * 3)); });
+
+    // Accumulator rotates and flag ops
+    measure("rla_inst", [&](u32 i) -> u32 { regs.set_a(static_cast<u8>(i)); inst.rla_inst(); return regs.get_a(); });
+    measure("rra_inst", [&](u32 i) -> u32 { regs.set_a(static_cast<u8>(i)); inst.rra_inst(); return regs.get_a(); });
+    measure("rlca_inst", [&](u32 i) -> u32 { regs.set_a(static_cast<u8>(i)); inst.rlca_inst(); return regs.get_a(); });
+    measure("rrca_inst", [&](u32 i) -> u32 { regs.set_a(static_cast<u8>(i)); inst.rrca_inst(); return regs.get_a(); });
+    measure("cpl_inst", [&](u32 i) -> u32 { regs.set_a(static_cast<u8>(i)); inst.cpl_inst(); return regs.get_a(); });
+    measure("ccf_inst", [&](u32) -> u32 { inst.ccf_inst(); return regs.get_f(); });
+    measure("scf_inst", [&](u32) -> u32 { inst.scf_inst(); return regs.get_f(); });
+
+    // CB-prefixed helpers
+    measure("bit_inst", [&](u32 i) -> u32 { inst.bit_inst(i & 7, static_cast<u8>(i >> 3)); return regs.get_f(); });
+    measure("res_inst", [&](u32 i) -> u32 { return inst.res_inst(i & 7, static_cast<u8>(i >> 3)); });
+    measure("set_inst", [&](u32 i) -> u32 { return inst.set_inst(i & 7, static_cast<u8>(i >> 3)); });
+    measure("rl_inst", [&](u32 i) -> u32 { return inst.rl_inst(static_cast<u8>(i)); });
+    measure("rr_inst", [&](u32 i) -> u32 { return inst.rr_inst(static_cast<u8>(i)); });
+    measure("rlc_inst", [&](u32 i) -> u32 { return inst.rlc_inst(static_cast<u8>(i)); });
+    measure("rrc_inst", [&](u32 i) -> u32 { return inst.rrc_inst(static_cast<u8>(i)); });
+    measure("sla_inst", [&](u32 i) -> u32 { return inst.sla_inst(static_cast<u8>(i)); });
+    measure("sra_inst", [&](u32 i) -> u32 { return inst.sra_inst(static_cast<u8>(i)); });
+    measure("srl_inst", [&](u32 i) -> u32 { return inst.srl_inst(static_cast<u8>(i)); });
+    measure("swap_inst", [&](u32 i) -> u32 { return inst.swap_inst(static_cast<u8>(i)); });
+
+    // Register accessors, targets rotate through the table like decoded instructions would
+    constexpr array<ArithmeticTarget, 7> REGISTERS = {ArithmeticTarget::A, ArithmeticTarget::B, ArithmeticTarget::C,
+                                                      ArithmeticTarget::D, ArithmeticTarget::E, ArithmeticTarget::H,
+                                                      ArithmeticTarget::L};
+    constexpr array<ArithmeticTarget, 4> PAIRS = {ArithmeticTarget::BC, ArithmeticTarget::DE, ArithmeticTarget::HL,
+                                                  ArithmeticTarget::AF};
+
+    measure("get_a", [&](u32) -> u32 { return regs.get_a(); });
+    measure("set_a", [&](u32 i) -> u32 { regs.set_a(static_cast<u8>(i)); return 0; });
+    measure("get_HL", [&](u32) -> u32 { return regs.get_HL(); });
+    measure("set_HL", [&](u32 i) -> u32 { regs.set_HL(static_cast<u16>(i)); return 0; });
+    measure("get_register", [&](u32 i) -> u32 { return regs.get_register(REGISTERS[i % 7]); });
+    measure("set_register", [&](u32 i) -> u32 { regs.set_register(REGISTERS[i % 7], static_cast<u8>(i)); return 0; });
+    measure("get_register_pair", [&](u32 i) -> u32 { return regs.get_register_pair(PAIRS[i & 3]); });
+    measure("set_register_pair", [&](u32 i) -> u32 { regs.set_register_pair(PAIRS[i & 3], static_cast<u16>(i)); return 0; });
+    measure("update_flag_register", [&](u32 i) -> u32 { flags.zero = i & 1; regs.update_flag_register(); return regs.get_f(); });
+    measure("read_next_byte", [&](u32 i) -> u32 { regs.set_PC(static_cast<u16>(0xC000 + (i & 0xFFF))); return regs.read_next_byte(); });
+
+    if (!counters.available())
+    {
+        cout << "(hardware counters unavailable, time only)" << endl;
+    }
+    return 0;
+}
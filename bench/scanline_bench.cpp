@@ -0,0 +1,90 @@
+#include "scanline.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+
+// Per-line timing of the scanline compositor: reference tile walk vs cached SIMD path
+auto main(int argc, char *argv[]) -> int
+{
+    u32 frames = (argc > 1) ? static_cast<u32>(stoul(argv[1])) : 2000;
+
+    Cartridge cart;
+    MemoryBus bus(&cart);
+    mt19937 rng(0x6B);
+
+    // Random tile data and both tile maps
+    for (u16 address = 0x8000; address < 0xA000; address++)
+    {
+        bus.write_byte(address, static_cast<u8>(rng()));
+    }
+
+    // Ten 8x8 sprites on every line, mixed flags
+    for (u8 i = 0; i < 40; i++)
+    {
+        bus.write_byte(0xFE00 + i * 4, 16 + (i / 10) * 36 + (i % 4) * 2);
+        bus.write_byte(0xFE01 + i * 4, 8 + (i % 10) * 16);
+        bus.write_byte(0xFE02 + i * 4, static_cast<u8>(rng()));
+        bus.write_byte(0xFE03 + i * 4, static_cast<u8>(rng()) & 0xF0);
+    }
+
+    const MemoryBus initial = bus;
+    const PaletteLUT lut = Compositor::build_lut(0xE4, 0xD2, 0x1B);
+    auto cache = make_unique<BackgroundCache>();
+    array<Colour, 160 * 144> scalar_frame = {};
+    array<Colour, 160 * 144> simd_frame = {};
+
+    // Both runs start from the same VRAM and apply the same writes
+    auto run = [&](bool reference, array<Colour, 160 * 144> &frame) -> double
+    {
+        bus = initial;
+        cache->invalidate();
+        mt19937 writes(0x42);
+
+        const array<u8, 4> lcdc = {0x93, 0x9B, 0xF3, 0x83};
+
+        auto start = chrono::steady_clock::now();
+        for (u32 f = 0; f < frames; f++)
+        {
+            // A few tile and map writes per frame, like a game updating its screen
+            for (u8 i = 0; i < 16; i++)
+            {
+                bus.write_byte(0x8000 + (writes() & 0x1FFF), static_cast<u8>(writes()));
+            }
+
+            ScanlineRegs regs{0, static_cast<u8>(f * 3), static_cast<u8>(f), lcdc[(f >> 6) & 3], static_cast<u8>(f % 170), static_cast<u8>(f % 150), 0};
+            for (regs.ly = 0; regs.ly < 144; regs.ly++)
+            {
+                if (reference)
+                {
+                    Compositor::compose_scalar(bus, regs, lut, &frame[regs.ly * 160]);
+                }
+                else
+                {
+                    cache->refresh(bus, regs.lcdc);
+                    Compositor::compose(bus, *cache, regs, lut, &frame[regs.ly * 160]);
+                }
+
+                if (Compositor::window_visible(regs))
+                {
+                    regs.window_line++;
+                }
+            }
+        }
+        auto elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start);
+        return elapsed.count() / (static_cast<double>(frames) * 144);
+    };
+
+    double scalar_ns = run(true, scalar_frame);
+    double simd_ns = run(false, simd_frame);
+
+    bool match = memcmp(scalar_frame.data(), simd_frame.data(), sizeof(scalar_frame)) == 0;
+
+    cout << "frames: " << frames << " (" << frames * 144 << " lines)" << endl;
+    cout << "reference: " << scalar_ns << " ns/line" << endl;
+    cout << "cached " << Compositor::simd_name() << ": " << simd_ns << " ns/line" << endl;
+    cout << "speedup: " << scalar_ns / simd_ns << "x" << endl;
+    cout << "output:  " << (match ? "identical" : "MISMATCH") << endl;
+
+    return match ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+#include "upscale.hpp"
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+// Per-frame cost of every upscaler at 4x and 6x, single thread vs pool, against a host budget
+auto main(int argc, char *argv[]) -> int
+{
+    u32 frames = (argc > 1) ? static_cast<u32>(stoul(argv[1])) : 300;
+    double budget_ms = (argc > 2) ? stod(argv[2]) : 2.0;
+
+    // Four shades with flat areas and edges, like a real DMG frame
+    const array<Colour, 4> shades = {{{0xE0, 0xF8, 0xD0}, {0x88, 0xC0, 0x70}, {0x34, 0x68, 0x56}, {0x08, 0x18, 0x20}}};
+    array<Colour, 160 * 144> frame = {};
+    mt19937 rng(0x6B);
+    for (u32 i = 0; i < frame.size(); i++)
+    {
+        frame[i] = shades[((i / 160) / 8 + (i % 160) / 8 + (rng() % 7 == 0)) & 3];
+    }
+
+    u8 threads = static_cast<u8>(clamp(thread::hardware_concurrency(), 1u, 4u));
+    ThreadPool single(1);
+    ThreadPool pool(threads);
+    auto serial = make_unique<Upscaler>(&single);
+    auto parallel = make_unique<Upscaler>(&pool);
+
+    vector<u32> out(160 * 6 * 144 * 6);
+    bool within = true;
+
+    auto time = [&](Upscaler &upscaler, ScaleFilter filter, u8 factor) -> double
+    {
+        auto start = chrono::steady_clock::now();
+        for (u32 f = 0; f < frames; f++)
+        {
+            upscaler.run(filter, factor, frame.data(), out.data(), 160 * factor);
+        }
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / frames;
+    };
+
+    cout << "frames: " << frames << ", threads: " << static_cast<u16>(threads) << ", budget: " << budget_ms << " ms/frame" << endl;
+    for (u8 factor : {4, 6})
+    {
+        for (ScaleFilter filter : {ScaleFilter::Nearest, ScaleFilter::Scale2x, ScaleFilter::Scale3x, ScaleFilter::LcdGrid})
+        {
+            if (Upscaler::fit_factor(filter, factor) != factor)
+            {
+                continue;
+            }
+
+            double one = time(*serial, filter, factor);
+            double many = time(*parallel, filter, factor);
+            within = within && many <= budget_ms;
+
+            cout << static_cast<u16>(factor) << "x " << Upscaler::filter_name(filter) << ": "
+                 << one << " ms (1 thread), " << many << " ms (" << static_cast<u16>(threads) << " threads) "
+                 << (many <= budget_ms ? "ok" : "OVER") << endl;
+        }
+    }
+
+    return within ? 0 : 1;
+}
@@ -1,8 +1,12 @@
 #ifndef BUS_HPP
 #define BUS_HPP
 
+#include <algorithm>
+#include <bitset>
+#include <functional>
 #include "common.hpp"
 #include "cart.hpp"
+#include "save_state.hpp"
 
 typedef class Colour
 {
@@ -19,7 +23,7 @@ public:
 class MemoryBus
 {
 private:
-    static constexpr u32 GAMEBOY_MEM = 0xFFFF;
+    static constexpr u32 GAMEBOY_MEM = 0x10000; // Up to and including IE at 0xFFFF
     static constexpr u16 BOOT_DMG = 0x00000;
     static constexpr u16 BOOT_DMG_SIZE = 0x00100;
     static constexpr u16 NINTENDO_LOGO_ADDR = 0x0104;
@@ -30,6 +34,14 @@ private:
 
     auto update_tile(u16 address, u8 value) -> void;
 
+    // VRAM, OAM and the LCD registers 0xFF40-0xFF4B
+    static constexpr auto is_video_address(u16 address) -> bool
+    {
+        return (address >= 0x8000 && address < 0xA000) || (address >= 0xFE00 && address < 0xFEA0) || (address >= 0xFF40 && address < 0xFF4C);
+    }
+
+    static constexpr auto is_timer_address(u16 address) -> bool { return address >= 0xFF04 && address < 0xFF08; }
+
 public:
     MemoryBus() = default;
 
@@ -49,19 +61,72 @@ public:
         Colour{0, 0, 0},
     };
 
+    // BGP, OBP0 or OBP1 as colours, two bits per shade from the lowest
+    static constexpr auto decode_palette(u8 value) -> array<Colour, 4>
+    {
+        array<Colour, 4> colours = {};
+        for (u8 i = 0; i < 4; i++)
+        {
+            colours[i] = palette[(value >> (i * 2)) & 3];
+        }
+        return colours;
+    }
+
     array<array<array<u8, 8>, 8>, 384> tiles = {};
+
+    // Set by VRAM writes, cleared by the PPU background cache
+    bitset<384> dirty_tiles;
+    bitset<2048> dirty_map;
+    bool vram_dirty = true;
+    bool tiles_stale = false; // tiles no longer match VRAM, after a state load
+
+    // Bumped whenever VRAM/OAM content actually changes
+    u32 vram_generation = 0;
+    u32 oam_generation = 0;
+
+    // Called before VRAM/OAM content changes, lets a render thread catch up
+    function<void()> video_write_barrier;
+
+    // Called before the CPU reads or writes video state, brings the PPU up to date
+    function<void()> video_sync;
+
+    // DIV/TIMA/TMA/TAC live in the timer, brought up to date before reads, writes go to it
+    function<void()> timer_sync;
+    function<void(u16, u8)> timer_write;
+
+    // P1 (0xFF00) writes go to the joypad, it keeps the readable value in memory
+    function<void(u8)> joypad_write;
+
+    // SC (0xFF02) writes go to the serial port, they may start a transfer
+    function<void(u8)> serial_write;
+
+    // Writes to debug_address go to the guest debug port, only set with --debug-port
+    u16 debug_address = 0;
+    function<void(u8)> debug_write;
+
+    // Called after IF (0xFF0F) or IE (0xFFFF) is written
+    function<void()> interrupt_changed;
+
     array<Colour, 4> palette_BGP = {};
     array<array<Colour, 4>, 2> palette_sprite = {};
 
     auto get_cart() const -> Cartridge * { return cart; }
 
-    auto read_byte(u16 address) const noexcept -> u8;
+    auto read_byte(u16 address) const -> u8;
+    auto peek(u16 address) const noexcept -> u8 { return memory[address]; } // No PPU sync, for the PPU itself
     auto write_byte(u16 address, u8 value) -> void;
 
     auto get_memory(u16 address) -> u8 &; // For reference
     auto set_memory(u16 address, u8 value) noexcept -> void;
 
+    auto decode_tiles() -> void; // All 384 tiles from VRAM
+
+    // RAM and I/O from 0x8000, the ROM area has to match and is only checked
+    auto save_state(StateWriter &out) const -> void;
+    auto load_state(StateReader &in) -> void;
+
     auto load_boot_dmg() -> void;
+    auto load_rom() -> void; // Cartridge ROM into 0x0000-0x7FFF
     auto load_test() -> void;
 };
 
@@ -1,6 +1,7 @@
 #ifndef CART_HPP
 #define CART_HPP
 
+#include <vector>
 #include "common.hpp"
 
 class Cartridge
@@ -8,10 +9,16 @@ class Cartridge
 private:
     static const array<u8, 0x30> nintendo_logo;
 
+    vector<u8> rom;
+
 public:
     Cartridge() = default;
 
     auto get_nintedo_logo() const -> const array<u8, 0x30> & { return nintendo_logo; }
+    auto get_rom() const -> const vector<u8> & { return rom; }
+
+    auto load(const string &path) -> void;
+    auto load_bytes(vector<u8> data) -> void; // ROM image built in memory
 };
 
 #endif // CART_HPP
\ No newline at end of file
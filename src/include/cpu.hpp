@@ -1,6 +1,7 @@
 #ifndef CPU_HPP
 #define CPU_HPP
 
+#include <bit>
 #include <bitset>
 #include <iomanip>
 #include <memory>
@@ -9,6 +10,13 @@
 #include "registers.hpp"
 #include "instructions.hpp"
 #include "ppu.hpp"
+#include "timer.hpp"
+#include "joypad.hpp"
+#include "serial.hpp"
+#include "opcode_stats.hpp"
+#include "frame_profiler.hpp"
+#include "guest_profiler.hpp"
+#include "debug_port.hpp"
 
 class CPU
 {
@@ -16,22 +24,69 @@ private:
     u8 instruction_byte = 0;
     u8 interrupt_triggered = 0;
 
-    u8 *div = 0;
-    u8 *tima = 0;
-    u8 *tma = 0;
-    u8 *tac = 0;
+    // Open interrupt handler spans, only while tracing. A span closes on the RET or RETI that pops
+    // the return address pushed at dispatch, SP is what tells, whichever way the handler returns
+    constexpr static array<const char *, 5> HANDLER_NAMES = {"vblank handler", "stat handler", "timer handler",
+                                                             "serial handler", "joypad handler"};
+    struct HandlerSpan
+    {
+        u64 begin = 0;
+        u16 sp = 0; // After the dispatch push
+        u8 bit = 0;
+    };
+    array<HandlerSpan, 4> handler_spans = {};
+    u8 handler_depth = 0;
+
+    u64 cycles = 0;       // M-cycles since power on
+    u64 instructions = 0; // Executed since power on
+    u64 halted_cycles = 0; // M-cycles spent in HALT
+    bool trace = false; // Log the state after every instruction to cpu_log.txt
 
     auto load_cpu_without_bootdmg() -> void;
 
     Registers *registers = nullptr;
     Instruction *inst = nullptr;
     PPU *ppu = nullptr;
+    FrameProfiler *profiler = nullptr; // Only with --frame-stats
+
+    GuestProfiler *guest_profiler = nullptr; // Only with --guest-profile
+    u64 sample_deadline = ~0ull;             // M-cycle of the next guest PC sample
+
+    DebugPort *debug_port = nullptr; // Only with --debug-port
+
+    Timer timer;
+    Joypad joypad;
+    Serial serial;
+
+#ifdef OPCODE_STATS
+    OpcodeStats opcode_stats;
+#endif
 
 public:
     CPU(Registers *regs_ptr, Instruction *inst_ptr, PPU *ppu_ptr);
 
+    auto get_cycles() const -> u64 { return cycles; }
+    auto get_instructions() const -> u64 { return instructions; }
+    auto get_halted_cycles() const -> u64 { return halted_cycles; }
+    auto get_joypad() -> Joypad & { return joypad; }
+    auto get_serial() const -> const Serial & { return serial; }
+#ifdef OPCODE_STATS
+    auto get_opcode_stats() const -> const OpcodeStats & { return opcode_stats; }
+#endif
+
+    auto set_trace(bool enabled) -> void { trace = enabled; }
+    auto set_profiler(FrameProfiler *profiler_ptr) -> void { profiler = profiler_ptr; }
+    auto set_guest_profiler(GuestProfiler *profiler_ptr) -> void;
+    auto set_debug_port(DebugPort *port_ptr) -> void;
+
+    // The whole machine, the same ROM has to be loaded and started first
+    auto save_state(vector<u8> &state) const -> void;
+    auto load_state(const vector<u8> &state) -> void;
+
+    auto boot() -> void;            // Run the DMG boot ROM
+    auto start_cartridge() -> void; // Skip the boot ROM, start at 0x0100
+
     auto log_state(const string &stage, u8 instruction_byte, bool prefixed) -> void;
-    auto timer(u8 cycle) -> void;
     auto interrupts() -> void;
     auto step() -> void;
     auto execute(const Instruction &instruction) -> u8;
@@ -0,0 +1,62 @@
+#ifndef DEBUG_PORT_HPP
+#define DEBUG_PORT_HPP
+
+#include "common.hpp"
+
+// Write-only I/O byte guest code uses to time itself, one command per write:
+//   0x00-0x3F  start region N        0x40-0x7F  stop region N
+//   0x80-0xBF  emit counter N        0xFF       stop the emulator
+// Regions record exact M-cycles and host time between start and stop, counters the spacing of their emits.
+class DebugPort
+{
+public:
+    static constexpr u16 DEFAULT_ADDRESS = 0xFF7F; // Unmapped on the DMG
+    static constexpr size_t CHANNELS = 64;
+
+private:
+    struct Region
+    {
+        u64 count = 0;
+        u64 cycles = 0;
+        u64 min_cycles = ~0ull;
+        u64 max_cycles = 0;
+        u64 host_ns = 0;
+
+        bool open = false;
+        u64 start_cycles = 0;
+        u64 start_ns = 0;
+        u64 trace_begin = 0;
+    };
+
+    // Spacing is summed one interval at a time so a restart can skip the interval across it
+    struct Counter
+    {
+        u64 count = 0;
+        u64 intervals = 0;
+        u64 interval_cycles = 0;
+        u64 interval_ns = 0;
+
+        bool started = false;
+        u64 last_cycles = 0;
+        u64 last_ns = 0;
+    };
+
+    u16 address;
+    array<Region, CHANNELS> regions = {};
+    array<Counter, CHANNELS> counters = {};
+    bool stop_requested = false;
+
+public:
+    DebugPort(u16 port_address = DEFAULT_ADDRESS);
+
+    static auto parse_address(const string &text) -> u16; // Hex, with or without 0x
+
+    auto get_address() const -> u16 { return address; }
+    auto is_stop_requested() const -> bool { return stop_requested; }
+
+    auto write(u8 command, u64 now) -> void; // now is the M-cycle the writing instruction started at
+    auto restart() -> void; // The M-cycle clock jumped, after a state load: drops open regions and counter spacing
+    auto report(ostream &out) const -> void;
+};
+
+#endif // DEBUG_PORT_HPP
@@ -0,0 +1,56 @@
+#ifndef FRAME_PACER_HPP
+#define FRAME_PACER_HPP
+
+#include <chrono>
+#include "common.hpp"
+
+enum class PacerMode
+{
+    Normal,      // 59.73 Hz
+    Turbo,       // Normal rate times the turbo multiplier
+    Unthrottled, // No waiting at all
+};
+
+// Holds the host thread to the DMG frame rate, sleeping most of the frame and spinning the rest
+class FramePacer
+{
+public:
+    // 70224 T-cycles per frame at 4.194304 MHz, about 59.73 Hz
+    static constexpr u64 FRAME_NS = 70224ull * 1'000'000'000ull / 4194304ull;
+
+private:
+    // Sleep wakeups are late by up to the timer slack, spin through the end
+    static constexpr u64 SPIN_NS = 200'000;
+
+    PacerMode mode = PacerMode::Normal;
+    u8 turbo_multiplier = 2;
+    u64 deadline = 0;
+
+    // Achieved frame times
+    u64 last_frame = 0;
+    u64 frames = 0;
+    u64 late_frames = 0;
+    u64 min_ns = ~0ull;
+    u64 max_ns = 0;
+    double sum_ns = 0.0;
+    double sum_sq_ns = 0.0;
+
+    static auto now() -> u64;
+    static auto sleep_until(u64 time) -> void;
+
+    auto record(u64 time) -> void;
+
+public:
+    auto get_mode() const -> PacerMode { return mode; }
+    auto set_mode(PacerMode pacer_mode) -> void;
+    auto set_turbo_multiplier(u8 multiplier) -> void;
+
+    auto frame_period() const -> u64; // ns per frame in the current mode
+
+    // Called once per emulated frame, returns when the next one may start
+    auto wait() -> void;
+
+    auto report(ostream &out) const -> void;
+};
+
+#endif // FRAME_PACER_HPP
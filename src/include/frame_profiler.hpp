@@ -0,0 +1,93 @@
+#ifndef FRAME_PROFILER_HPP
+#define FRAME_PROFILER_HPP
+
+#include <vector>
+#include "common.hpp"
+#include "host_ticks.hpp"
+
+enum class FrameSection
+{
+    Other,      // Main loop and the timers themselves, anything not covered below
+    Cpu,        // CPU::execute
+    Timer,      // Timer sync and register access
+    Interrupts, // Interrupt dispatch
+    Ppu,        // PPU stepping and scanline rendering
+    Present,    // Frame conversion, upload and SDL present
+    Count,
+};
+
+// Host time of each emulated frame split by subsystem, reported as percentiles every REPORT_FRAMES
+class FrameProfiler
+{
+private:
+    static constexpr size_t SECTIONS = static_cast<size_t>(FrameSection::Count);
+    static constexpr u32 REPORT_FRAMES = 600; // About 10 s at 59.73 Hz
+    static constexpr size_t MAX_DEPTH = 8;
+
+    // Exclusive ticks, a nested section pauses the one it interrupts
+    array<u64, SECTIONS> frame_ticks = {};
+    array<FrameSection, MAX_DEPTH> stack = {};
+    size_t depth = 0;
+    u64 section_start = 0;
+
+    u64 frame_start_ticks = 0;
+    u64 frame_start_ns = 0;
+    bool in_frame = false;
+
+    // Per-frame ns of each section plus the total, since the last report
+    array<vector<u32>, SECTIONS + 1> samples;
+
+    auto charge() -> void
+    {
+        u64 now = host_ticks();
+        frame_ticks[static_cast<size_t>(stack[depth])] += now - section_start;
+        section_start = now;
+    }
+
+public:
+    auto enter(FrameSection section) -> void
+    {
+        charge();
+        stack[++depth] = section;
+    }
+
+    auto leave() -> void
+    {
+        charge();
+        depth--;
+    }
+
+    auto begin_frame() -> void;
+    auto end_frame() -> void; // Reports once REPORT_FRAMES are collected
+
+    auto report(ostream &out) -> void;
+};
+
+// Charges the enclosing scope to a section, does nothing without a profiler
+class ProfileScope
+{
+private:
+    FrameProfiler *profiler;
+
+public:
+    ProfileScope(FrameProfiler *profiler_ptr, FrameSection section) : profiler(profiler_ptr)
+    {
+        if (profiler)
+        {
+            profiler->enter(section);
+        }
+    }
+
+    ~ProfileScope()
+    {
+        if (profiler)
+        {
+            profiler->leave();
+        }
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    auto operator=(const ProfileScope &) -> ProfileScope & = delete;
+};
+
+#endif // FRAME_PROFILER_HPP
@@ -2,6 +2,7 @@
 #define GAMEBOY_HPP
 
 #include "common.hpp"
+#include "joypad.hpp"
 #include "SDL2/SDL.h"
 
 // #define RAM_SIZE 8192
@@ -15,11 +16,16 @@ enum GameBoy_states {
 
 struct GameBoy {
     GameBoy_states state;
+    bool turbo = false; // Held turbo key
+    bool overlay = false; // Performance overlay, toggled with F1
+    bool save_state = false; // F5, handled and cleared by the main loop
+    bool load_state = false; // F9
     // std::array<u8, RAM_SIZE> WRAM;
     // std::array<u8, RAM_SIZE> VRAM;
     // std::array<u8, ROM_SIZE> ROM;
 };
 
-void keyboard(GameBoy *gb);
+// Polled once per frame, joypad changes are queued at the given CPU cycle
+void keyboard(GameBoy *gb, Joypad *joypad, u64 cycle);
 
 #endif    //GAMEBOY_HPP
\ No newline at end of file
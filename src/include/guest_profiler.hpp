@@ -0,0 +1,52 @@
+#ifndef GUEST_PROFILER_HPP
+#define GUEST_PROFILER_HPP
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "common.hpp"
+
+// Samples the guest PC every period M-cycles, keeps a shadow call stack from CALL/RST/interrupt entry
+// and RET/RETI, and writes a flat profile plus folded stacks for flame graphs.
+// Addresses are keyed as bank << 16 | address, with RGBDS .sym files naming them.
+class GuestProfiler
+{
+private:
+    static constexpr size_t MAX_DEPTH = 64;
+
+    struct Frame
+    {
+        u32 entry; // Banked address of the called routine
+        u16 sp;    // SP right after the return address was pushed
+    };
+
+    u32 period;
+    vector<Frame> stack;
+
+    unordered_map<u32, u64> flat;          // Banked PC -> samples
+    map<vector<u32>, u64> stacks;          // Entries outermost first, then the banked PC -> samples
+    map<u32, string> symbols;              // Banked address -> label
+    u64 total = 0;
+
+    // No memory bank controller yet, 0x4000-0x7FFF is always bank 1
+    static auto banked(u16 address) -> u32 { return (address >= 0x4000 && address < 0x8000) ? (1u << 16) | address : address; }
+
+    auto name(u32 address) const -> string;    // Containing label, or BB:AAAA
+    auto routine(u32 address) const -> string; // Label without a .local suffix
+
+public:
+    GuestProfiler(u32 sample_period);
+
+    auto get_period() const -> u32 { return period; }
+
+    auto load_symbols(const string &path) -> void;
+
+    auto enter(u16 target, u16 sp) -> void; // CALL, RST or interrupt dispatch
+    auto leave(u16 sp) -> void;             // RET/RETI with SP after the pop
+    auto sample(u16 pc, u64 weight) -> void;
+
+    // Flat profile to path, folded stacks to path + ".folded"
+    auto write(const string &path) const -> void;
+};
+
+#endif // GUEST_PROFILER_HPP
@@ -0,0 +1,27 @@
+#ifndef HOST_TICKS_HPP
+#define HOST_TICKS_HPP
+
+#include <chrono>
+#include "common.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Monotonic wall time in ns, for spans reported in real units
+inline auto steady_ns() -> u64
+{
+    return static_cast<u64>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Cheapest monotonic host counter: TSC on x86, steady_clock ns elsewhere
+inline auto host_ticks() -> u64
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return steady_ns();
+#endif
+}
+
+#endif // HOST_TICKS_HPP
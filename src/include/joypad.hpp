@@ -0,0 +1,59 @@
+#ifndef JOYPAD_HPP
+#define JOYPAD_HPP
+
+#include <deque>
+#include "common.hpp"
+#include "registers.hpp"
+
+// Bit of each button in the pressed mask, low nibble is the d-pad
+enum class Button : u8
+{
+    Right,
+    Left,
+    Up,
+    Down,
+    A,
+    B,
+    Select,
+    Start,
+};
+
+struct InputEvent
+{
+    u64 cycle = 0; // CPU M-cycle the change takes effect
+    Button button = Button::A;
+    bool pressed = false;
+};
+
+// P1 (0xFF00) kept current in bus memory, input changes are applied at their cycle
+class Joypad
+{
+private:
+    u8 pressed = 0;
+    u8 select = 0x30; // P1 bits 4-5, low selects d-pad / buttons
+
+    deque<InputEvent> queue;
+    u64 deadline = ~0ull;
+
+    u8 *p1 = 0;
+    Registers *registers = nullptr;
+
+    auto update() -> void;
+
+public:
+    Joypad(Registers *regs_ptr);
+
+    auto get_deadline() const -> u64 { return deadline; }
+    auto get_pressed() const -> u8 { return pressed; }
+
+    // Events must come in cycle order, the frontend queues them once per frame
+    auto push(const InputEvent &event) -> void;
+
+    auto sync(u64 now) -> void;
+    auto write(u8 value) -> void;
+    // Pressed buttons and select, queued input is dropped
+    auto save_state(StateWriter &out) const -> void;
+    auto load_state(StateReader &in) -> void;
+};
+
+#endif // JOYPAD_HPP
@@ -0,0 +1,58 @@
+#ifndef OPCODE_STATS_HPP
+#define OPCODE_STATS_HPP
+
+// Built only with -DENABLE_OPCODE_STATS=ON, the CPU has no trace of it otherwise
+#ifdef OPCODE_STATS
+
+#include "common.hpp"
+#include "host_ticks.hpp"
+#include "instructions.hpp"
+
+// Executions and M-cycles per opcode (256 unprefixed + 256 CB), sampled host time per InstructionType
+class OpcodeStats
+{
+private:
+    static constexpr size_t TYPE_COUNT = static_cast<size_t>(InstructionType::CB) + 1;
+    static constexpr u32 SAMPLE_PERIOD = 64; // Time one instruction in this many
+    static constexpr size_t MAX_CYCLES = 32; // Histogram buckets, interrupts add 5 to the worst case
+
+    array<u64, 512> counts = {};
+    array<u64, 512> cycles = {};
+    array<u64, MAX_CYCLES> histogram = {};
+
+    array<u64, TYPE_COUNT> type_ticks = {};
+    array<u64, TYPE_COUNT> type_samples = {};
+    u32 countdown = SAMPLE_PERIOD;
+
+public:
+    // Returns 0 unless this instruction is sampled
+    auto begin() -> u64
+    {
+        if (--countdown != 0)
+        {
+            return 0;
+        }
+        countdown = SAMPLE_PERIOD;
+        return host_ticks();
+    }
+
+    auto record(u8 opcode, bool prefixed, InstructionType type, u8 cycle, u64 start) -> void
+    {
+        if (start != 0)
+        {
+            type_ticks[static_cast<size_t>(type)] += host_ticks() - start;
+            type_samples[static_cast<size_t>(type)]++;
+        }
+
+        size_t index = (prefixed ? 256 : 0) + opcode;
+        counts[index]++;
+        cycles[index] += cycle;
+        histogram[min<size_t>(cycle, MAX_CYCLES - 1)]++;
+    }
+
+    auto report(ostream &out) const -> void;
+};
+
+#endif // OPCODE_STATS
+
+#endif // OPCODE_STATS_HPP
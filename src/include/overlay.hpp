@@ -0,0 +1,64 @@
+#ifndef OVERLAY_HPP
+#define OVERLAY_HPP
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include "common.hpp"
+
+// Running totals the overlay turns into rates, sampled once per emulated frame
+struct OverlayCounters
+{
+    u64 cycles = 0;
+    u64 instructions = 0;
+    u64 halted_cycles = 0;
+    u32 frames = 0;
+    u32 skipped_frames = 0;
+};
+
+// Speed, FPS, MIPS, halted time, skipped frames and a host frame-time graph drawn over the picture.
+// The text goes through SDL_ttf only when it differs from what the cached texture shows.
+class Overlay
+{
+private:
+    static constexpr u32 UPDATE_FRAMES = 30;   // Text values are averages over half a second
+    static constexpr size_t GRAPH_FRAMES = 120; // Frame times kept for the graph
+    static constexpr int FONT_SIZE = 14;
+
+    TTF_Font *font = nullptr;
+    bool visible = false;
+
+    // Text of the current window, and what text_texture was rendered from
+    string text;
+    string rendered_text;
+    SDL_Texture *text_texture = nullptr;
+    int text_width = 0;
+    int text_height = 0;
+
+    OverlayCounters window_start = {};
+    u64 window_start_ns = 0;
+    u64 last_frame_ns = 0;
+
+    array<u32, GRAPH_FRAMES> frame_times = {}; // Host ns, oldest at graph_head
+    size_t graph_head = 0;
+
+    auto refresh_texture(SDL_Renderer *renderer) -> void;
+
+public:
+    Overlay(const string &font_path);
+    ~Overlay();
+
+    Overlay(const Overlay &) = delete;
+    auto operator=(const Overlay &) -> Overlay & = delete;
+
+    // First of the usual system monospace fonts that exists, empty if none
+    static auto find_font() -> string;
+
+    auto is_visible() const -> bool { return visible; }
+    auto set_visible(bool show) -> void { visible = show; }
+
+    auto frame(const OverlayCounters &counters) -> void;
+    auto restart_window() -> void { window_start_ns = 0; } // The counters jumped, after a state load
+    auto draw(SDL_Renderer *renderer) -> void; // Into the output in window pixels
+};
+
+#endif // OVERLAY_HPP
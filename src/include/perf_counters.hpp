@@ -0,0 +1,58 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include "common.hpp"
+
+// Hardware counter values over one start/stop interval, or a sum of them
+struct PerfSample
+{
+    u64 cycles = 0;
+    u64 instructions = 0;
+    u64 branch_misses = 0;
+    u64 l1d_misses = 0; // L1 data cache read misses
+
+    auto operator+=(const PerfSample &other) -> PerfSample &
+    {
+        cycles += other.cycles;
+        instructions += other.instructions;
+        branch_misses += other.branch_misses;
+        l1d_misses += other.l1d_misses;
+        return *this;
+    }
+};
+
+// Host CPU counters for this thread through perf_event_open, inert where unsupported or not permitted.
+// Cycles and instructions are required, branch and L1D misses are added when the PMU has them.
+class PerfCounters
+{
+private:
+    enum Event : size_t
+    {
+        CYCLES, // Group leader
+        INSTRUCTIONS,
+        BRANCH_MISSES,
+        L1D_MISSES,
+        EVENT_COUNT,
+    };
+
+    array<int, EVENT_COUNT> fds = {-1, -1, -1, -1};
+
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters &) = delete;
+    auto operator=(const PerfCounters &) -> PerfCounters & = delete;
+
+    auto available() const -> bool { return fds[CYCLES] >= 0; }
+    auto has_branch_misses() const -> bool { return fds[BRANCH_MISSES] >= 0; }
+    auto has_l1d_misses() const -> bool { return fds[L1D_MISSES] >= 0; }
+
+    auto start() -> void;
+    auto stop() -> PerfSample;
+
+    // Host events per guest instruction, misses per 1000, what a dispatch or cache regression shows up in
+    auto report(ostream &out, const PerfSample &sample, u64 guest_instructions) const -> void;
+};
+
+#endif // PERF_COUNTERS_HPP
@@ -1,30 +1,25 @@
 #ifndef PPU_HPP
 #define PPU_HPP
 
+#include <vector>
 #include "common.hpp"
 #include "registers.hpp"
+#include "scanline.hpp"
+#include "render_thread.hpp"
+#include "upscale.hpp"
+#include "frame_profiler.hpp"
+#include "overlay.hpp"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_timer.h>
 #include <SDL2/SDL_ttf.h>
 
-struct Sprite
+// How finished scanlines are stored until they are presented or captured
+enum class FrameFormat
 {
-    u8 y;
-    u8 x;
-    u8 tile;
-    union
-    {
-        struct Flags
-        {
-            u8 palette : 1;
-            u8 hFlip : 1;
-            u8 vFlip : 1;
-            u8 render_priority : 1;
-            u8 unused : 4;
-        } bits;
-        u8 flags;
-    } options;
+    Rgb,     // 3 bytes per pixel
+    Indexed, // Shade 0-3, 1 byte per pixel
+    Packed,  // Shade 0-3, 4 pixels per byte
 };
 
 class PPU
@@ -33,9 +28,20 @@ private:
     constexpr static u8 SCREEN_WIDTH = 160;
     constexpr static u8 SCREEN_HEIGHT = 144;
 
-    array<Colour, 160 * 144> frame_buffer;    // 160X144
+    // M-cycles spent in H-Blank, V-Blank line, OAM scan and pixel transfer
+    constexpr static array<u16, 4> MODE_CYCLES = {51, 114, 20, 43};
+    constexpr static u16 LINE_CYCLES = 114;
+    constexpr static u8 WRAP_LINE = 153; // LY wraps to 0 when V-Blank reaches it
+
+    // Only the buffer of the current format is allocated
+    FrameFormat frame_format = FrameFormat::Rgb;
+    vector<Colour> frame_buffer;  // 160X144
+    vector<u8> shade_buffer;      // Indexed or Packed shades
+    vector<Colour> rgb_buffer;    // Compact frames converted for presenting
 
     u16 ppu_cycle = 0;
+    u64 synced_cycle = 0; // CPU M-cycle the PPU state belongs to
+    u64 deadline = 0;     // CPU M-cycle of the next interrupt or frame present
     u8 mode = 0;
     u8 *control = 0;
     u8 *stat = 0;
@@ -43,30 +49,89 @@ private:
     u8 *lyc = 0;
     u8 *scy = 0; // Scroll Y
     u8 *scx = 0; // Scroll X
+    u8 *wy = 0;  // Window Y
+    u8 *wx = 0;  // Window X + 7
     u8 *interrupt_flag = 0;
 
+    BackgroundCache background;
+    u8 window_line = 0;
+
+    // Signatures of the lines currently in frame_buffer
+    array<LineSignature, 144> line_signatures = {};
+    bool frame_changed = true;
+
+    u8 frame_skip = 0; // Skip N of every M frames
+    u8 frame_period = 1;
+    u32 frame_count = 0;
+    u32 skipped_frames = 0; // Not rendered because of the frame skip pattern
+    bool render_enabled = true;
+
+    bool headless = false; // Frames are only kept for capture_frame
+
     SDL_Rect texture_rect = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
 
     SDL_Renderer *renderer;
     SDL_Window *window;
     SDL_Texture *texture;
 
+    // Filtered output at an integer multiple of the window, made on the CPU
+    ScaleFilter filter = ScaleFilter::None;
+    unique_ptr<ThreadPool> scale_pool;
+    unique_ptr<Upscaler> upscaler;
+    SDL_Texture *scaled_texture = nullptr;
+    u8 scaled_factor = 0;
+
+    unique_ptr<Overlay> overlay; // Only with a window and a font
+
     MemoryBus *bus = nullptr;
     Registers *registers = nullptr;
+    FrameProfiler *profiler = nullptr;
+
+    // Declared last so the worker stops before anything it renders into
+    unique_ptr<RenderThread> render_thread;
+
+    auto render_line(const LineSignature &line) -> void;
+    auto upload_scaled(const Colour *frame) -> SDL_Texture *;
+    auto convert_frame() -> const Colour *; // RGB view of the current frame
+    auto cycles_to_next_interrupt() const -> u16;
 
 public:
-    PPU(MemoryBus *bus_ptr, Registers *regs_ptr);
+    PPU(MemoryBus *bus_ptr, Registers *regs_ptr, bool headless_mode = false);
 
     bool frame_drawn_flag = 0;
 
     auto get_ppu_cycle() const -> u8 { return ppu_cycle; }
+    auto get_frame_count() const -> u32 { return frame_count; }
+    auto get_skipped_frames() const -> u32 { return skipped_frames; }
+    auto get_deadline() const -> u64 { return deadline; }
+
+    auto set_frame_skip(u8 skip, u8 period) -> void;
+    auto set_render_thread(bool enabled) -> void;
+    auto set_filter(ScaleFilter scale_filter) -> void;
+    auto set_frame_format(FrameFormat format) -> void;
+    auto set_profiler(FrameProfiler *profiler_ptr) -> void { profiler = profiler_ptr; }
+    auto enable_overlay(const string &font_path) -> void;
+    auto get_overlay() -> Overlay * { return overlay.get(); }
+
+    static auto parse_frame_format(const string &name) -> FrameFormat;
+
+    // Finished frame in RGB whatever the storage format
+    auto capture_frame() -> vector<Colour>;
 
     auto init() -> void;
     auto draw_scanline() -> void;
     auto draw_frame() -> void;
-    auto step(u8 cycle) -> void;
+    auto step(u16 cycle) -> void;
+
+    // Lazy stepping: catch_up before the CPU touches video state, sync at the deadline
+    auto catch_up(u64 now) -> void;
+    auto sync(u64 now) -> void;
     auto compare_ly_lyc() -> void;
     auto quit() -> void;
+
+    // Timing and frame counters, the picture renders again from the restored VRAM
+    auto save_state(StateWriter &out) const -> void;
+    auto load_state(StateReader &in) -> void;
 };
 
 #endif // GPU_HPP
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "common.hpp"
 #include "bus.hpp"
+#include "save_state.hpp"
 
 enum
 {
@@ -51,6 +52,13 @@ private:
     u8 IME = 0;
     u8 is_halted = 0;
 
+    // IE/IF live in bus memory, the pending bit is recomputed whenever they, IME or halt change
+    u8 *interrupt_enable = 0;
+    u8 *interrupt_flag = 0;
+    bool interrupt_pending = false;
+
+    auto update_interrupt_pending() -> void;
+
     u8 a = 0;
     u8 b = 0;
     u8 c = 0;
@@ -71,6 +79,11 @@ public:
         {
             throw runtime_error("Null pointer provided to Registers constructor");
         }
+
+        interrupt_enable = &bus->get_memory(0xFFFF);
+        interrupt_flag = &bus->get_memory(0xFF0F);
+        bus->interrupt_changed = [this]()
+        { update_interrupt_pending(); };
     }
 
     auto get_bus() const -> MemoryBus * { return bus; }
@@ -132,7 +145,15 @@ public:
     auto is_interrupt_enabled(u8 flag) -> u8;
     auto is_interrupt_flag_set(u8 flag) -> u8;
 
+    // Requested and enabled, with IME set or the CPU halted
+    auto has_interrupt_pending() const -> bool { return interrupt_pending; }
+    auto requested_interrupts() const -> u8 { return *interrupt_enable & *interrupt_flag & 0x1F; }
+
     auto trigger_interrupt(u8 flag, u8 value) -> void;
+
+    // Flags included, IE/IF come with the bus
+    auto save_state(StateWriter &out) const -> void;
+    auto load_state(StateReader &in) -> void;
 };
 
 #endif // REGISTERS_HPP
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef RENDER_THREAD_HPP
+#define RENDER_THREAD_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "common.hpp"
+#include "scanline.hpp"
+
+// Renders queued scanline snapshots on a worker thread
+class RenderThread
+{
+private:
+    static constexpr u16 QUEUE_SIZE = 256;
+    static constexpr u16 CAPACITY = QUEUE_SIZE - 1; // A completely full ring would look empty
+
+    array<LineSignature, QUEUE_SIZE> queue = {};
+    u16 head = 0;
+    u16 tail = 0;
+    bool stopping = false;
+
+    atomic<u16> pending = 0; // Queued + in progress
+
+    mutex lock;
+    condition_variable work_ready;
+    condition_variable work_done;
+
+    function<void(const LineSignature &)> render;
+    thread worker;
+
+    auto run() -> void;
+
+public:
+    RenderThread(function<void(const LineSignature &)> render_fn);
+    ~RenderThread();
+
+    RenderThread(const RenderThread &) = delete;
+    auto operator=(const RenderThread &) -> RenderThread & = delete;
+
+    auto push(const LineSignature &line) -> void; // Blocks while the ring is full
+    auto drain() -> void; // Wait until every queued line is rendered
+};
+
+#endif // RENDER_THREAD_HPP
@@ -0,0 +1,70 @@
+#ifndef SAVE_STATE_HPP
+#define SAVE_STATE_HPP
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "common.hpp"
+
+// Save state layout: magic, version, payload size, then each component's fields as raw host-order copies.
+// Bump STATE_VERSION whenever a component saves something different.
+constexpr u32 STATE_MAGIC = 0x53534247; // "GBSS" read back on a host of the same byte order
+constexpr u32 STATE_VERSION = 1;
+constexpr size_t STATE_HEADER_SIZE = 3 * sizeof(u32);
+
+class StateWriter
+{
+private:
+    vector<u8> &data;
+
+public:
+    StateWriter(vector<u8> &buffer);
+
+    template <typename T>
+    auto put(const T &value) -> void
+    {
+        static_assert(is_trivially_copyable_v<T>);
+        put_bytes(&value, sizeof(T));
+    }
+
+    auto put_bytes(const void *source, size_t size) -> void
+    {
+        size_t offset = data.size();
+        data.resize(offset + size);
+        memcpy(data.data() + offset, source, size);
+    }
+
+    auto finish() -> void; // Fills in the payload size
+};
+
+class StateReader
+{
+private:
+    const vector<u8> &data;
+    size_t offset = STATE_HEADER_SIZE;
+
+public:
+    StateReader(const vector<u8> &buffer); // Checks the header, throws on a foreign or outdated state
+
+    template <typename T>
+    auto get(T &value) -> void
+    {
+        static_assert(is_trivially_copyable_v<T>);
+        get_bytes(&value, sizeof(T));
+    }
+
+    auto get_bytes(void *target, size_t size) -> void
+    {
+        if (size > data.size() - offset)
+        {
+            throw runtime_error("Save state is truncated");
+        }
+        memcpy(target, data.data() + offset, size);
+        offset += size;
+    }
+};
+
+auto write_state_file(const string &path, const vector<u8> &state) -> void;
+auto read_state_file(const string &path) -> vector<u8>;
+
+#endif // SAVE_STATE_HPP
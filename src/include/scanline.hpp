@@ -0,0 +1,120 @@
+#ifndef SCANLINE_HPP
+#define SCANLINE_HPP
+
+#include "common.hpp"
+#include "bus.hpp"
+
+// Colour ids produced by the compositor: 0-3 BGP, 4-7 OBP0, 8-11 OBP1
+constexpr u8 COLOUR_ID_OBP0 = 4;
+constexpr u8 COLOUR_ID_OBP1 = 8;
+
+struct Sprite
+{
+    u8 y;
+    u8 x;
+    u8 tile;
+    union
+    {
+        struct Flags
+        {
+            u8 unused : 4;
+            u8 palette : 1;
+            u8 hFlip : 1;
+            u8 vFlip : 1;
+            u8 render_priority : 1;
+        } bits;
+        u8 flags;
+    } options;
+};
+
+struct PaletteLUT
+{
+    alignas(16) array<u8, 16> r = {};
+    alignas(16) array<u8, 16> g = {};
+    alignas(16) array<u8, 16> b = {};
+    alignas(16) array<u8, 16> shade = {}; // DMG shade 0-3 of each colour id
+};
+
+struct ScanlineRegs
+{
+    u8 ly = 0;
+    u8 scx = 0;
+    u8 scy = 0;
+    u8 lcdc = 0;
+    u8 wx = 0;
+    u8 wy = 0;
+    u8 window_line = 0; // Internal window line counter
+
+    auto operator==(const ScanlineRegs &other) const -> bool = default;
+};
+
+// Everything a scanline's pixels depend on, equal signatures give equal pixels
+struct LineSignature
+{
+    u32 vram_generation = 0;
+    u32 oam_generation = 0;
+    ScanlineRegs regs;
+    u8 bgp = 0;
+    u8 obp0 = 0;
+    u8 obp1 = 0;
+    bool valid = false;
+
+    auto operator==(const LineSignature &other) const -> bool = default;
+};
+
+// Both 32x32 tile maps decoded into 256x256 colour id bitmaps
+class BackgroundCache
+{
+private:
+    alignas(16) array<array<u8, 256 * 256>, 2> bitmap = {};
+
+    bool valid = false;
+    bool tile_data_select = false;
+
+public:
+    static auto tile_index(u8 index, u8 lcdc) -> u16 { return (lcdc & 0x10) ? index : 256 + static_cast<i8>(index); }
+
+    // Redraws the map entries touched by VRAM writes or an LCDC tile data switch
+    auto refresh(MemoryBus &bus, u8 lcdc) -> void;
+    auto invalidate() -> void { valid = false; }
+
+    auto row(u8 map, u8 y) const -> const u8 * { return &bitmap[map][y * 256]; }
+};
+
+class Compositor
+{
+public:
+    static constexpr u8 LINE_WIDTH = 160;
+    static constexpr u8 LINE_GUARD = 8;   // Sprites may start up to 8 pixels left of the screen
+    static constexpr u8 MAX_SPRITES = 10; // Per scanline
+
+    using LineBuffer = array<u8, LINE_WIDTH + 2 * LINE_GUARD>;
+
+    static auto simd_name() -> const char *;
+    static auto build_lut(u8 bgp, u8 obp0, u8 obp1) -> PaletteLUT;
+
+    static auto window_visible(const ScanlineRegs &regs) -> bool;
+
+    // Full scanline: background, window and sprites, mapped to RGB
+    static auto compose(const MemoryBus &bus, const BackgroundCache &cache, const ScanlineRegs &regs, const PaletteLUT &lut, Colour *out) -> void;
+    // Reference path: tile walk instead of the cache, no SIMD
+    static auto compose_scalar(const MemoryBus &bus, const ScanlineRegs &regs, const PaletteLUT &lut, Colour *out) -> void;
+    // Same scanline as one shade (0-3) per byte, for compact frame buffers
+    static auto compose_shades(const MemoryBus &bus, const BackgroundCache &cache, const ScanlineRegs &regs, const PaletteLUT &lut, u8 *out) -> void;
+
+    // Four shades per byte, first pixel in the low bits
+    static auto pack_shades(const u8 *shades, u8 *out) -> void;
+    static auto unpack_shades(const u8 *packed, u8 *out) -> void;
+    static auto shades_to_rgb(const u8 *shades, Colour *out) -> void;
+
+    // Individual stages, ids are written at LINE_GUARD offset
+    static auto blit_background(const BackgroundCache &cache, const ScanlineRegs &regs, LineBuffer &line) -> void;
+    static auto expand_background(const MemoryBus &bus, const ScanlineRegs &regs, LineBuffer &line) -> void;
+    template <bool simd>
+    static auto merge_sprites(const MemoryBus &bus, const ScanlineRegs &regs, LineBuffer &line) -> void;
+    template <bool simd>
+    static auto map_palette(const u8 *ids, const PaletteLUT &lut, Colour *out) -> void;
+    static auto map_shades(const u8 *ids, const PaletteLUT &lut, u8 *out) -> void;
+};
+
+#endif // SCANLINE_HPP
@@ -0,0 +1,45 @@
+#ifndef SERIAL_HPP
+#define SERIAL_HPP
+
+#include "common.hpp"
+#include "registers.hpp"
+
+enum class SerialResult
+{
+    None,
+    Passed,
+    Failed,
+};
+
+// SB/SC (0xFF01/0xFF02) with no link partner, sent bytes are captured for test ROM runs
+class Serial
+{
+private:
+    // 8 bits at 8192 Hz on the internal clock
+    constexpr static u16 TRANSFER_CYCLES = 8 * 128;
+
+    u64 deadline = ~0ull; // CPU M-cycle the running transfer completes
+
+    string output;
+    SerialResult result = SerialResult::None;
+
+    u8 *sb = 0;
+    u8 *sc = 0;
+
+    Registers *registers = nullptr;
+
+public:
+    Serial(Registers *regs_ptr);
+
+    auto get_deadline() const -> u64 { return deadline; }
+    auto get_output() const -> const string & { return output; }
+    auto get_result() const -> SerialResult { return result; }
+
+    auto sync(u64 now) -> void;
+    auto write_control(u8 value, u64 now) -> void;
+    // The running transfer, captured output stays with the session
+    auto save_state(StateWriter &out) const -> void;
+    auto load_state(StateReader &in) -> void;
+};
+
+#endif // SERIAL_HPP
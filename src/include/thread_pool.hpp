@@ -0,0 +1,44 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "common.hpp"
+
+// Fixed set of workers running indexed tasks, the caller takes part too
+class ThreadPool
+{
+private:
+    vector<thread> workers;
+
+    function<void(u32)> task;
+    u32 task_count = 0;
+    u32 next_task = 0;
+    u32 tasks_done = 0;
+    u64 generation = 0;
+    bool stopping = false;
+
+    mutex lock;
+    condition_variable work_ready;
+    condition_variable work_done;
+
+    auto run_worker() -> void;
+    auto run_tasks(unique_lock<mutex> &guard) -> void;
+
+public:
+    ThreadPool(u8 threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    auto operator=(const ThreadPool &) -> ThreadPool & = delete;
+
+    auto size() const -> u8 { return static_cast<u8>(workers.size() + 1); }
+
+    // Runs task(0..count-1) and returns once all of them finished
+    auto run(u32 count, function<void(u32)> fn) -> void;
+};
+
+#endif // THREAD_POOL_HPP
@@ -0,0 +1,43 @@
+#ifndef TIMER_HPP
+#define TIMER_HPP
+
+#include "common.hpp"
+#include "registers.hpp"
+
+// DIV/TIMA derived from the CPU cycle count, only brought up to date when read or at the next overflow
+class Timer
+{
+private:
+    // Divider bit whose falling edge ticks TIMA, per TAC clock select
+    constexpr static array<u8, 4> TIMA_BITS = {9, 3, 5, 7};
+
+    u64 divider_start = 0; // CPU M-cycle the 16-bit divider was last 0
+    u64 synced_cycle = 0;  // CPU M-cycle TIMA in memory belongs to
+    u64 deadline = 0;      // CPU M-cycle of the next TIMA overflow
+
+    u8 *div = 0;
+    u8 *tima = 0;
+    u8 *tma = 0;
+    u8 *tac = 0;
+
+    Registers *registers = nullptr;
+
+    // Unwrapped divider, counts T-cycles
+    auto divider(u64 now) const -> u64 { return (now - divider_start) * 4; }
+    auto tima_period() const -> u64 { return 2ull << TIMA_BITS[*tac & 3]; }
+
+    auto tick(u64 edges) -> void;
+    auto schedule() -> void;
+
+public:
+    Timer(Registers *regs_ptr);
+
+    auto get_deadline() const -> u64 { return deadline; }
+
+    auto sync(u64 now) -> void;
+    auto write(u16 address, u8 value, u64 now) -> void;
+    auto save_state(StateWriter &out) const -> void;
+    auto load_state(StateReader &in) -> void;
+};
+
+#endif // TIMER_HPP
@@ -0,0 +1,85 @@
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "common.hpp"
+
+// One complete span, names and categories are string literals
+struct TraceEvent
+{
+    const char *name = nullptr;
+    const char *category = nullptr;
+    u64 begin_ns = 0;
+    u64 end_ns = 0;
+    const char *arg_name = nullptr; // Optional integer argument
+    u64 arg = 0;
+};
+
+// Host timeline of the emulator as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev).
+// Each thread appends to its own ring without locks, the newest RING_SIZE spans per thread are kept.
+class Tracer
+{
+private:
+    static constexpr u64 RING_SIZE = 1 << 18;
+
+    struct Ring
+    {
+        vector<TraceEvent> events = vector<TraceEvent>(RING_SIZE);
+        atomic<u64> head = 0; // Spans ever recorded, only the owning thread writes
+        u32 tid = 0;
+        string name;
+    };
+
+    static inline atomic<bool> active = false;
+    static inline u64 epoch = 0;
+
+    // Rings outlive their threads so the spans can be written at exit
+    static inline mutex rings_lock;
+    static inline vector<unique_ptr<Ring>> rings;
+
+    static auto local_ring() -> Ring &;
+
+public:
+    static auto enabled() -> bool { return active.load(memory_order_relaxed); }
+
+    static auto start() -> void;
+    static auto now() -> u64; // ns since start
+
+    static auto set_thread_name(const string &name) -> void;
+    static auto record(const TraceEvent &event) -> void;
+
+    // Call once every traced thread has stopped
+    static auto write(const string &path) -> void;
+};
+
+// Span from construction to destruction, free when tracing is off
+class TraceScope
+{
+private:
+    TraceEvent event;
+
+public:
+    TraceScope(const char *name, const char *category, const char *arg_name = nullptr, u64 arg = 0)
+    {
+        if (Tracer::enabled())
+        {
+            event = {name, category, Tracer::now(), 0, arg_name, arg};
+        }
+    }
+
+    ~TraceScope()
+    {
+        if (event.name)
+        {
+            event.end_ns = Tracer::now();
+            Tracer::record(event);
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    auto operator=(const TraceScope &) -> TraceScope & = delete;
+};
+
+#endif // TRACER_HPP
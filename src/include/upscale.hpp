@@ -0,0 +1,47 @@
+#ifndef UPSCALE_HPP
+#define UPSCALE_HPP
+
+#include "common.hpp"
+#include "bus.hpp"
+#include "thread_pool.hpp"
+
+enum class ScaleFilter
+{
+    None, // SDL scales the 160x144 texture
+    Nearest,
+    Scale2x,
+    Scale3x,
+    LcdGrid,
+};
+
+// CPU upscalers producing XRGB8888 output, split into bands over a thread pool
+class Upscaler
+{
+private:
+    static constexpr u16 SOURCE_WIDTH = 160;
+    static constexpr u16 SOURCE_HEIGHT = 144;
+    static constexpr u16 PADDED_WIDTH = SOURCE_WIDTH + 2;
+    static constexpr u8 BANDS = 16;
+
+    // Frame as XRGB8888 with a replicated 1 pixel border, saves edge checks in the EPX filters
+    alignas(32) array<u32, PADDED_WIDTH *(SOURCE_HEIGHT + 2)> padded = {};
+
+    ThreadPool *pool = nullptr;
+
+    auto load_frame(const Colour *frame) -> void;
+    auto scale_rows(ScaleFilter filter, u8 factor, u16 first, u16 last, u32 *out, u32 pitch) const -> void;
+
+public:
+    Upscaler(ThreadPool *pool_ptr);
+
+    static auto parse_filter(const string &name) -> ScaleFilter;
+    static auto filter_name(ScaleFilter filter) -> const char *;
+
+    // Largest factor not above max_factor that the filter supports
+    static auto fit_factor(ScaleFilter filter, u8 max_factor) -> u8;
+
+    // out holds (160 * factor) x (144 * factor) pixels, pitch is in pixels
+    auto run(ScaleFilter filter, u8 factor, const Colour *frame, u32 *out, u32 pitch) -> void;
+};
+
+#endif // UPSCALE_HPP
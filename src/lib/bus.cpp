@@ -1,43 +1,117 @@
 #include "bus.hpp"
+#include "tracer.hpp"
 
-auto MemoryBus::read_byte(u16 address) const noexcept -> u8
+auto MemoryBus::read_byte(u16 address) const -> u8
 {
+    if (video_sync && is_video_address(address))
+    {
+        video_sync();
+    }
+    else if (timer_sync && is_timer_address(address))
+    {
+        timer_sync();
+    }
     return memory[address];
 }
 
 auto MemoryBus::write_byte(u16 address, u8 value) -> void
 {
+    if (video_sync && is_video_address(address))
+    {
+        video_sync();
+    }
+    else if (timer_write && is_timer_address(address))
+    {
+        timer_write(address, value);
+        return;
+    }
+    else if (joypad_write && address == 0xFF00)
+    {
+        joypad_write(value);
+        return;
+    }
+    else if (serial_write && address == 0xFF02)
+    {
+        serial_write(value);
+        return;
+    }
+    else if (debug_write && address == debug_address)
+    {
+        debug_write(value);
+        return;
+    }
+
+    if (address < 0x8000) // ROM, no memory bank controller yet
+    {
+        return;
+    }
+
     if (address == 0xFF46) // Copy sprite from ROM to RAM
     {
+        TraceScope scope("oam dma", "bus", "source", value << 8);
         for (u16 i = 0; i < 160; i++)
         {
             write_byte(0xFE00 + i, read_byte((value << 8) + i));
         }
     }
-    else if (address >= 0x8000 && address < 0x9800) // Update tile
+    else if (address >= 0x8000 && address < 0xA000) // VRAM
     {
-        update_tile(address, value);
+        if (memory[address] == value)
+        {
+            return;
+        }
+
+        if (video_write_barrier)
+        {
+            video_write_barrier();
+        }
+        memory[address] = value;
+        vram_generation++;
+
+        if (address < 0x9800) // Update tile
+        {
+            update_tile(address, value);
+        }
+        else // Update tile map
+        {
+            dirty_map.set(address - 0x9800);
+            vram_dirty = true;
+        }
+        return;
     }
-    else if (address == 0xFF47) // Update palette BGP
+    else if (address >= 0xFE00 && address < 0xFEA0) // OAM
     {
-        for (u8 i = 0; i < 4; i++)
+        if (memory[address] == value)
+        {
+            return;
+        }
+
+        if (video_write_barrier)
         {
-            palette_BGP[i] = palette[(value >> (i * 2)) & 3];
+            video_write_barrier();
         }
+        oam_generation++;
     }
-    else if (address == 0xFF48) // Update palette sprite 1
+    else if (address == 0xFF0F || address == 0xFFFF) // Interrupt flags or enable
     {
-        for (u8 i = 0; i < 4; i++)
+        memory[address] = (address == 0xFF0F) ? (value | 0xE0) : value; // Upper IF bits read as 1
+        if (interrupt_changed)
         {
-            palette_sprite[0][i] = palette[(value >> (i * 2)) & 3];
-        }  
+            interrupt_changed();
+        }
+        return;
     }
-    else if (address == 0xFF48) // Update palette sprite 2
+    else if (address == 0xFF47) // Update palette BGP
     {
-        for (u8 i = 0; i < 4; i++)
-        {
-            palette_sprite[1][i] = palette[(value >> (i * 2)) & 3];
-        }  
+        palette_BGP = decode_palette(value);
+    }
+    else if (address == 0xFF48) // Update palette sprite 1
+    {
+        palette_sprite[0] = decode_palette(value);
+    }
+    else if (address == 0xFF49) // Update palette sprite 2
+    {
+        palette_sprite[1] = decode_palette(value);
     }
 
     memory[address] = value;
@@ -48,14 +122,60 @@ auto MemoryBus::update_tile(u16 address, u8 value) -> void
     (void)value;
     address &= 0x1FFE;
 
-    u8 tile = (address >> 4) & 511;
+    u16 tile = (address >> 4) & 511;
     u8 y = (address >> 1) & 7;
+    address += 0x8000;
 
     for (u8 x = 0; x < 8; x++)
     {
         u8 bit = 1 << (7 - x);
         tiles[tile][y][x] = ((memory[address] & bit) ? 1 : 0) + ((memory[address + 1] & bit) ? 2 : 0);
     }
+
+    dirty_tiles.set(tile);
+    vram_dirty = true;
+}
+
+auto MemoryBus::decode_tiles() -> void
+{
+    for (u16 address = 0; address < 0x1800; address += 2)
+    {
+        update_tile(address, 0);
+    }
+    tiles_stale = false;
+}
+
+auto MemoryBus::save_state(StateWriter &out) const -> void
+{
+    out.put_bytes(memory.data() + 0x0100, 0x50); // Entry point, logo and header identify the ROM
+    out.put_bytes(memory.data() + 0x8000, GAMEBOY_MEM - 0x8000);
+}
+
+auto MemoryBus::load_state(StateReader &in) -> void
+{
+    array<u8, 0x50> header = {};
+    in.get_bytes(header.data(), header.size());
+    if (!equal(header.begin(), header.end(), memory.begin() + 0x0100))
+    {
+        throw runtime_error("Save state belongs to a different ROM");
+    }
+
+    if (video_write_barrier)
+    {
+        video_write_barrier();
+    }
+    in.get_bytes(memory.data() + 0x8000, GAMEBOY_MEM - 0x8000);
+
+    // Decoded views of the registers and VRAM, the tiles wait for the next scanline
+    palette_BGP = decode_palette(memory[0xFF47]);
+    palette_sprite[0] = decode_palette(memory[0xFF48]);
+    palette_sprite[1] = decode_palette(memory[0xFF49]);
+    tiles_stale = true;
+    dirty_tiles.set();
+    dirty_map.set();
+    vram_dirty = true;
+    vram_generation++;
+    oam_generation++;
 }
 
 auto MemoryBus::get_memory(u16 address) -> u8 &
@@ -65,10 +185,7 @@ auto MemoryBus::get_memory(u16 address) -> u8 &
 
 auto MemoryBus::set_memory(u16 address, u8 value) noexcept -> void
 {
-    if (address < GAMEBOY_MEM)
-    {
-        memory[address] = value;
-    }
+    memory[address] = value;
 }
 
 auto MemoryBus::load_boot_dmg() -> void
@@ -100,6 +217,18 @@ auto MemoryBus::load_boot_dmg() -> void
     }
 }
 
+auto MemoryBus::load_rom() -> void
+{
+    const vector<u8> &rom = cart->get_rom();
+    if (rom.empty())
+    {
+        throw runtime_error("No cartridge ROM loaded");
+    }
+
+    // Without banking only the first 32 KB are reachable
+    copy_n(rom.begin(), min<size_t>(rom.size(), 0x8000), memory.begin());
+}
+
 auto MemoryBus::load_test() -> void
 {
     ifstream file("/home/sashok63/c++/gameboy/test/DMG_ROM.bin", ios::binary | ios::ate);
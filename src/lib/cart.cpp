@@ -7,4 +7,34 @@ const array<u8, 0x30> Cartridge::nintendo_logo = {
     0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99,
     0xBB, 0xBB, 0x67, 0x63, 0x6E, 0x0E, 0xEC, 0xCC,
     0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E
-};
\ No newline at end of file
+};
+
+auto Cartridge::load(const string &path) -> void
+{
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file.is_open())
+    {
+        throw runtime_error("Failed to open ROM '" + path + "'");
+    }
+
+    streamsize file_size = file.tellg();
+    vector<u8> data(static_cast<size_t>(file_size));
+    file.seekg(0, ios::beg);
+    file.read(reinterpret_cast<char *>(data.data()), file_size);
+    if (!file)
+    {
+        throw runtime_error("Failed to read the entire ROM '" + path + "'");
+    }
+
+    load_bytes(std::move(data));
+}
+
+auto Cartridge::load_bytes(vector<u8> data) -> void
+{
+    if (data.size() < 0x150)
+    {
+        throw runtime_error("ROM is too small to hold a header");
+    }
+
+    rom = std::move(data);
+}
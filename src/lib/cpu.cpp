@@ -1,23 +1,107 @@
 #include "cpu.hpp"
+#include "tracer.hpp"
 
 CPU::CPU(Registers *regs_ptr, Instruction *inst_ptr, PPU *ppu_ptr)
-    : registers(regs_ptr), inst(inst_ptr), ppu(ppu_ptr)
+    : registers(regs_ptr), inst(inst_ptr), ppu(ppu_ptr), timer(regs_ptr), joypad(regs_ptr), serial(regs_ptr)
 {
     if (!registers || !inst || !ppu)
     {
         throw runtime_error("Null pointer provided to CPU constructor");
     }
 
-    div = &registers->get_bus()->get_memory(0xFF04);
-    tima = &registers->get_bus()->get_memory(0xFF05);
-    tma = &registers->get_bus()->get_memory(0xFF06);
-    tac = &registers->get_bus()->get_memory(0xFF07);
+    // Video state the CPU touches has to be current, the PPU otherwise runs only at its deadlines
+    registers->get_bus()->video_sync = [this]()
+    {
+        ProfileScope scope(profiler, FrameSection::Ppu);
+        ppu->catch_up(cycles);
+    };
+
+    registers->get_bus()->timer_sync = [this]()
+    {
+        ProfileScope scope(profiler, FrameSection::Timer);
+        timer.sync(cycles);
+    };
+    registers->get_bus()->timer_write = [this](u16 address, u8 value)
+    {
+        ProfileScope scope(profiler, FrameSection::Timer);
+        timer.write(address, value, cycles);
+    };
+    registers->get_bus()->joypad_write = [this](u8 value)
+    { joypad.write(value); };
+    registers->get_bus()->serial_write = [this](u8 value)
+    { serial.write_control(value, cycles); };
+};
+
+auto CPU::set_guest_profiler(GuestProfiler *profiler_ptr) -> void
+{
+    guest_profiler = profiler_ptr;
+    sample_deadline = guest_profiler ? cycles + guest_profiler->get_period() : ~0ull;
+}
+
+auto CPU::set_debug_port(DebugPort *port_ptr) -> void
+{
+    debug_port = port_ptr;
+    MemoryBus *bus = registers->get_bus();
+    if (!debug_port)
+    {
+        bus->debug_write = nullptr;
+        return;
+    }
+
+    // cycles is still the M-cycle the writing instruction started at
+    bus->debug_address = debug_port->get_address();
+    bus->debug_write = [this](u8 value)
+    { debug_port->write(value, cycles); };
+}
+
+auto CPU::save_state(vector<u8> &state) const -> void
+{
+    StateWriter out(state);
+    registers->get_bus()->save_state(out);
+    registers->save_state(out);
+    out.put(cycles);
+    out.put(instructions);
+    out.put(halted_cycles);
+    out.put(interrupt_triggered);
+    timer.save_state(out);
+    joypad.save_state(out);
+    serial.save_state(out);
+    ppu->save_state(out);
+    out.finish();
+}
 
+auto CPU::load_state(const vector<u8> &state) -> void
+{
+    // The bus goes first, it rejects a state of another ROM before anything changes
+    StateReader in(state);
+    registers->get_bus()->load_state(in);
+    registers->load_state(in);
+    in.get(cycles);
+    in.get(instructions);
+    in.get(halted_cycles);
+    in.get(interrupt_triggered);
+    timer.load_state(in);
+    joypad.load_state(in);
+    serial.load_state(in);
+    ppu->load_state(in);
+
+    // Open handler spans and the sample schedule belong to the old timeline
+    handler_depth = 0;
+    sample_deadline = guest_profiler ? cycles + guest_profiler->get_period() : ~0ull;
+}
+
+auto CPU::boot() -> void
+{
     registers->get_bus()->load_boot_dmg();
     registers->set_PC(0x0000);
-    // load_cpu_without_bootdmg();
     // registers->get_bus()->load_test();
-};
+}
+
+auto CPU::start_cartridge() -> void
+{
+    registers->get_bus()->load_rom();
+    load_cpu_without_bootdmg();
+}
 
 auto CPU::load_cpu_without_bootdmg() -> void
 {
@@ -467,10 +551,12 @@ auto CPU::execute(const Instruction &instruction) -> u8
 
     case InstructionType::PUSH:
         push_inst(registers->get_register_pair(instruction.get_arithmetic_target()));
+        cycle = instruction.get_cycle_value();
         return cycle;
 
     case InstructionType::POP:
         registers->set_register_pair(instruction.get_arithmetic_target(), pop_inst());
+        cycle = instruction.get_cycle_value();
         return cycle;
 
     case InstructionType::CALL:
@@ -480,9 +566,13 @@ auto CPU::execute(const Instruction &instruction) -> u8
         if (jump_condition)
         {
             u16 operand = registers->get_bus()->read_byte(registers->get_PC() - 1) |
-                          (registers->get_bus()->read_byte(registers->get_PC() - 2) >> 8);
-            push_inst(registers->get_PC());
-            registers->set_PC(operand - 1); // Prevent inc in CPU Step
+                          (registers->get_bus()->read_byte(registers->get_PC()) << 8);
+            push_inst(registers->get_PC() + 1); // Address of the next instruction, like RST and interrupts
+            registers->set_PC(operand - 1);     // Prevent inc in CPU Step
+            if (guest_profiler)
+            {
+                guest_profiler->enter(operand, registers->get_SP());
+            }
         }
         cycle = jump_condition ? 6 : 3;
         return cycle;
@@ -497,11 +587,16 @@ auto CPU::execute(const Instruction &instruction) -> u8
         jump_condition = inst->check_jump_condition(instruction.get_jump_condition());
         if (jump_condition)
         {
-            registers->set_PC(pop_inst());
-        }
-        else
-        {
-            registers->set_PC(registers->get_PC() + 1);
+            registers->set_PC(pop_inst() - 1); // Prevent inc in CPU Step
+            if (guest_profiler)
+            {
+                guest_profiler->leave(registers->get_SP());
+            }
+            while (handler_depth > 0 && handler_spans[handler_depth - 1].sp < registers->get_SP())
+            {
+                const HandlerSpan &span = handler_spans[--handler_depth];
+                Tracer::record({HANDLER_NAMES[span.bit], "interrupt", span.begin, Tracer::now(), "vector", 0x40u + span.bit * 8u});
+            }
         }
 
         if (instruction_byte == 0xC9 || instruction_byte == 0xD9)
@@ -519,7 +614,7 @@ auto CPU::execute(const Instruction &instruction) -> u8
         return cycle;
 
     case InstructionType::HALT:
-        // this->is_halted = true;
+        registers->set_is_halted(1); // Ends at the next requested interrupt, even with IME clear
         cycle = instruction.get_cycle_value();
         return cycle;
 
@@ -583,6 +678,10 @@ auto CPU::execute(const Instruction &instruction) -> u8
             throw runtime_error("Unknown instruction_byte found at step: 0x" + to_string(instruction_byte));
             break;
         }
+        if (guest_profiler)
+        {
+            guest_profiler->enter(registers->get_PC() + 1, registers->get_SP());
+        }
         cycle = instruction.get_cycle_value();
         return cycle;
     }
@@ -599,121 +698,118 @@ auto CPU::execute(const Instruction &instruction) -> u8
 
 auto CPU::step() -> void
 {
-    u8 cycle = 0;
-    instruction_byte = registers->get_bus()->read_byte(registers->get_PC());
-    bool prefixed = (instruction_byte == 0xCB);
+    // Everything here is CPU time except the nested timer, interrupt and PPU scopes
+    ProfileScope cpu_scope(profiler, FrameSection::Cpu);
 
-    if (prefixed)
+    u64 cycle = 0;
+    if (registers->get_is_halted() && !registers->has_interrupt_pending())
     {
-        instruction_byte = registers->get_bus()->read_byte(registers->get_PC() + 1);
+        // Only a component event can raise an interrupt to wake up, skip straight to the next one.
+        // One raised by the last sync wakes the CPU below without skipping
+        u64 wake = min({timer.get_deadline(), joypad.get_deadline(), serial.get_deadline(), ppu->get_deadline()});
+        cycle = (wake > cycles) ? wake - cycles : 1;
+        halted_cycles += cycle;
     }
-
-    const Instruction *inst = Instruction::from_byte(instruction_byte, prefixed);
-    if (inst != nullptr)
+    else
     {
+        instruction_byte = registers->get_bus()->read_byte(registers->get_PC());
+        bool prefixed = (instruction_byte == 0xCB);
+
+        if (prefixed)
+        {
+            instruction_byte = registers->get_bus()->read_byte(registers->get_PC() + 1);
+        }
+
+        const Instruction *inst = Instruction::from_byte(instruction_byte, prefixed);
+        if (inst == nullptr)
+        {
+            throw runtime_error("Unknown instruction found at step: 0x" + to_string(registers->get_PC()));
+        }
+
         // log_state("Before execute", instruction_byte, prefixed);
+#ifdef OPCODE_STATS
+        u64 sample_start = opcode_stats.begin();
+#endif
         cycle = execute(*inst);
+        instructions++;
         registers->set_PC(registers->get_PC() + (prefixed ? 2 : 1));
         if (prefixed)
         {
             cycle += 1;
         }
-        log_state("After execute", instruction_byte, prefixed);
-    }
-    else
-    {
-        throw runtime_error("Unknown instruction found at step: 0x" + to_string(registers->get_PC()));
+#ifdef OPCODE_STATS
+        opcode_stats.record(instruction_byte, prefixed, inst->get_inst_type(), static_cast<u8>(cycle), sample_start);
+#endif
+        if (trace)
+        {
+            log_state("After execute", instruction_byte, prefixed);
+        }
     }
 
     // Implement cycles in cpu(step)
-    interrupts();
+    if (registers->has_interrupt_pending())
+    {
+        ProfileScope scope(profiler, FrameSection::Interrupts);
+        interrupts();
+    }
     if (interrupt_triggered)
     {
         cycle += 5; // Add 5 M-cycles per truggered interrupt
         interrupt_triggered = 0;
     }
-    timer(cycle);     // Pass the M-cycle
-    ppu->step(cycle); // Pass the M-cycle
-
-    if (registers->get_PC() == 0x00FA)
+    // Timer, joypad, serial and PPU are only stepped at their next event or when the CPU touches them
+    cycles += cycle;
+    if (cycles >= timer.get_deadline())
     {
-        cout << "Reached" << endl;
-        exit(0);
+        ProfileScope scope(profiler, FrameSection::Timer);
+        timer.sync(cycles);
     }
-    // if (instruction_byte == 0x0027)
-    // {
-    //     exit(0);
-    // }
-    // if (registers->get_SP() == 0x002C)
-    // {
-    //     exit(0);
-    // }
-}
-
-auto CPU::timer(u8 cycle) -> void
-{
-    // Update DIV register (increment every 64 M-cycles)
-    *div += cycle;
-    if (*div >= 64)
+    if (cycles >= joypad.get_deadline())
     {
-        *div -= 63;
+        joypad.sync(cycles);
     }
-
-    // Check if timer is enabled (TAC bit 2)
-    if (*tac & 0x4)
+    if (cycles >= serial.get_deadline())
     {
-        *tima += cycle;
-
-        u32 freq_lut[4] = {256, 4, 16, 64};
-        u32 freq = freq_lut[*tac & 3];
-
-        // Increment TIMA when enough cycles have passed
-        while (*tima >= freq)
-        {
-            (*tima)++;
-
-            // Check for overflow (TIMA == 0 after increment)
-            if (*tima == 0)
-            {
-                // Trigger Timer Overflow interrupt
-                registers->set_interrupt_flag(INTERRUPT_TIMER);
-                // Reload TIMA from TMA
-                *tima = *tma;
-            }
-            *tima -= freq; // Adjust remaining cycles
-        }
+        serial.sync(cycles);
     }
-}
-
-auto CPU::interrupts() -> void
-{
-    if (registers->get_bus()->read_byte(0xFFFF) & registers->get_bus()->read_byte(0xFF0F))
+    if (cycles >= ppu->get_deadline())
     {
-        registers->set_is_halted(0);
+        ProfileScope scope(profiler, FrameSection::Ppu);
+        ppu->sync(cycles);
     }
 
-    if (registers->is_interrupt_enabled(INTERRUPT_VBANK) && registers->is_interrupt_flag_set(INTERRUPT_VBANK))
+    // A long HALT skip covers several sample points, all land on the wakeup PC
+    if (cycles >= sample_deadline)
     {
-        registers->trigger_interrupt(INTERRUPT_VBANK, 0x40);
-        interrupt_triggered = 1;
+        u64 samples = (cycles - sample_deadline) / guest_profiler->get_period() + 1;
+        guest_profiler->sample(registers->get_PC(), samples);
+        sample_deadline += samples * guest_profiler->get_period();
     }
+}
 
-    if (registers->is_interrupt_enabled(INTERRUPT_LCD) && registers->is_interrupt_flag_set(INTERRUPT_LCD))
+auto CPU::interrupts() -> void
+{
+    u8 requested = registers->requested_interrupts();
+
+    // A requested interrupt always ends halt, it is only serviced with IME set
+    registers->set_is_halted(0);
+    if (!registers->get_IME())
     {
-        registers->trigger_interrupt(INTERRUPT_LCD, 0x48);
-        interrupt_triggered = 1;
+        return;
     }
 
-    if (registers->is_interrupt_enabled(INTERRUPT_TIMER) && registers->is_interrupt_flag_set(INTERRUPT_TIMER))
+    // Lowest bit has the highest priority, vectors are 0x40, 0x48, 0x50, 0x58 and 0x60
+    u8 bit = countr_zero(requested);
+    registers->trigger_interrupt(1 << bit, 0x40 + bit * 8);
+    interrupt_triggered = 1;
+    if (guest_profiler)
     {
-        registers->trigger_interrupt(INTERRUPT_TIMER, 0x50);
-        interrupt_triggered = 1;
+        guest_profiler->enter(0x40 + bit * 8, registers->get_SP());
     }
 
-    if (registers->is_interrupt_enabled(INTERRUPT_JOYPAD) && registers->is_interrupt_flag_set(INTERRUPT_JOYPAD))
+    if (Tracer::enabled() && handler_depth < handler_spans.size())
     {
-        registers->trigger_interrupt(INTERRUPT_JOYPAD, 0x60);
-        interrupt_triggered = 1;
+        handler_spans[handler_depth++] = {Tracer::now(), registers->get_SP(), bit};
     }
 }
 
@@ -766,15 +862,15 @@ auto CPU::log_state(const string &stage, u8 instruction_byte, bool prefixed) ->
              << " | C: " << registers->get_flag()->carry
              << endl;
 
-    log_file << "Memory regs: LY = " << hex << setw(2) << setfill('0') << static_cast<u16>(registers->get_bus()->read_byte(0xFF44))
-             << ", LYC = " << hex << setw(2) << setfill('0') << static_cast<u16>(registers->get_bus()->read_byte(0xFF45))
-             << ", SCY = " << hex << setw(2) << setfill('0') << static_cast<u16>(registers->get_bus()->read_byte(0xFF42))
-             << ", SCX = " << hex << setw(2) << setfill('0') << static_cast<u16>(registers->get_bus()->read_byte(0xFF43))
-             << ", LCDC = " << bitset<8>(registers->get_bus()->read_byte(0xFF40))
-             << ", STAT = " << bitset<8>(registers->get_bus()->read_byte(0xFF41))
+    log_file << "Memory regs: LY = " << hex << setw(2) << setfill('0') << static_cast<u16>(registers->get_bus()->peek(0xFF44))
+             << ", LYC = " << hex << setw(2) << setfill('0') << static_cast<u16>(registers->get_bus()->peek(0xFF45))
+             << ", SCY = " << hex << setw(2) << setfill('0') << static_cast<u16>(registers->get_bus()->peek(0xFF42))
+             << ", SCX = " << hex << setw(2) << setfill('0') << static_cast<u16>(registers->get_bus()->peek(0xFF43))
+             << ", LCDC = " << bitset<8>(registers->get_bus()->peek(0xFF40))
+             << ", STAT = " << bitset<8>(registers->get_bus()->peek(0xFF41))
              << endl;
 
-    log_file << "Timers: CPU = " << hex << setw(2) << setfill('0') << static_cast<u16>(*div)
+    log_file << "Timers: CPU = " << hex << setw(2) << setfill('0') << static_cast<u16>(registers->get_bus()->peek(0xFF04))
              << ", GPU = " << hex << setw(2) << setfill('0') << static_cast<u16>(ppu->get_ppu_cycle())
              << endl;
     // Debug output
@@ -0,0 +1,155 @@
+#include "debug_port.hpp"
+#include "tracer.hpp"
+#include "host_ticks.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+// I/O the DMG leaves unmapped. A live register would either win over the port on the bus,
+// so it never fires, or lose the write the guest meant for it (IF, LCDC, DMA, sound)
+auto is_unmapped_io(u16 address) -> bool
+{
+    return address == 0xFF03 || (address >= 0xFF08 && address <= 0xFF0E) || address == 0xFF15 || address == 0xFF1F ||
+           (address >= 0xFF27 && address <= 0xFF2F) || (address >= 0xFF4C && address <= 0xFF7F && address != 0xFF50);
+}
+} // namespace
+
+DebugPort::DebugPort(u16 port_address) : address(port_address)
+{
+    if (!is_unmapped_io(address))
+    {
+        ostringstream text;
+        text << "Debug port must be an unused I/O address (FF03, FF08-FF0E, FF15, FF1F, FF27-FF2F or FF4C-FF7F "
+             << "except FF50), got: " << hex << uppercase << address;
+        throw runtime_error(text.str());
+    }
+}
+
+auto DebugPort::parse_address(const string &text) -> u16
+{
+    size_t end = 0;
+    unsigned long value = stoul(text, &end, 16);
+    if (end != text.size() || value > 0xFFFF)
+    {
+        throw runtime_error("Expected a hex address, got: " + text);
+    }
+    return static_cast<u16>(value);
+}
+
+auto DebugPort::write(u8 command, u64 now) -> void
+{
+    size_t channel = command & 0x3F;
+    switch (command >> 6)
+    {
+    case 0: // Start, a second start restarts the region
+    {
+        Region &region = regions[channel];
+        region.open = true;
+        region.start_cycles = now;
+        region.start_ns = steady_ns();
+        region.trace_begin = Tracer::enabled() ? Tracer::now() : 0;
+        break;
+    }
+    case 1: // Stop, ignored without a start
+    {
+        Region &region = regions[channel];
+        if (!region.open)
+        {
+            break;
+        }
+        u64 cycles = now - region.start_cycles;
+        region.open = false;
+        region.count++;
+        region.cycles += cycles;
+        region.min_cycles = min(region.min_cycles, cycles);
+        region.max_cycles = max(region.max_cycles, cycles);
+        region.host_ns += steady_ns() - region.start_ns;
+        if (Tracer::enabled())
+        {
+            Tracer::record({"guest region", "guest", region.trace_begin, Tracer::now(), "region", channel});
+        }
+        break;
+    }
+    case 2: // Counter
+    {
+        Counter &counter = counters[channel];
+        u64 ns = steady_ns();
+        if (counter.started)
+        {
+            counter.intervals++;
+            counter.interval_cycles += now - counter.last_cycles;
+            counter.interval_ns += ns - counter.last_ns;
+        }
+        counter.count++;
+        counter.started = true;
+        counter.last_cycles = now;
+        counter.last_ns = ns;
+        break;
+    }
+    default:
+        if (command == 0xFF)
+        {
+            stop_requested = true;
+        }
+        break;
+    }
+}
+
+auto DebugPort::restart() -> void
+{
+    for (Region &region : regions)
+    {
+        region.open = false;
+    }
+    for (Counter &counter : counters)
+    {
+        counter.started = false;
+    }
+}
+
+auto DebugPort::report(ostream &out) const -> void
+{
+    out << "debug port 0x" << hex << uppercase << address << dec << nouppercase << ":" << endl;
+    out << left << fixed << setprecision(1) << setw(8) << "region" << setw(10) << "count" << setw(14) << "M-cycles"
+        << setw(12) << "mean" << setw(12) << "min" << setw(12) << "max" << setw(12) << "host us" << "speed" << endl;
+    for (size_t i = 0; i < CHANNELS; i++)
+    {
+        const Region &region = regions[i];
+        if (region.count == 0)
+        {
+            continue;
+        }
+
+        // Host time against the 1.048576 MHz of the emulated clock
+        double mean = static_cast<double>(region.cycles) / static_cast<double>(region.count);
+        double emulated_ns = static_cast<double>(region.cycles) * 1e9 / 1'048'576.0;
+        double speed = region.host_ns ? emulated_ns / static_cast<double>(region.host_ns) : 0.0;
+        out << setw(8) << i << setw(10) << region.count << setw(14) << region.cycles << setw(12) << mean
+            << setw(12) << region.min_cycles << setw(12) << region.max_cycles << setw(12)
+            << static_cast<double>(region.host_ns) / 1e3 << speed << "x" << endl;
+    }
+
+    bool header = false;
+    for (size_t i = 0; i < CHANNELS; i++)
+    {
+        const Counter &counter = counters[i];
+        if (counter.count == 0)
+        {
+            continue;
+        }
+        if (!header)
+        {
+            out << setw(8) << "counter" << setw(10) << "count" << setw(14) << "M-cycles/emit" << "host us/emit" << endl;
+            header = true;
+        }
+
+        // Spacing needs two emits
+        double intervals = static_cast<double>(counter.intervals);
+        double cycles = counter.intervals ? static_cast<double>(counter.interval_cycles) / intervals : 0.0;
+        double us = counter.intervals ? static_cast<double>(counter.interval_ns) / 1e3 / intervals : 0.0;
+        out << setw(8) << i << setw(10) << counter.count << setw(14) << cycles << us << endl;
+    }
+    out << right;
+}
@@ -0,0 +1,121 @@
+#include "frame_pacer.hpp"
+#include <cerrno>
+#include <cmath>
+#include <thread>
+
+#if defined(__linux__)
+#include <time.h>
+#endif
+
+auto FramePacer::now() -> u64
+{
+    return static_cast<u64>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+auto FramePacer::sleep_until(u64 time) -> void
+{
+#if defined(__linux__)
+    // steady_clock is CLOCK_MONOTONIC on Linux, absolute wakeups do not drift with late returns
+    timespec wake = {static_cast<time_t>(time / 1'000'000'000), static_cast<long>(time % 1'000'000'000)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) == EINTR)
+    {
+    }
+#else
+    this_thread::sleep_until(chrono::steady_clock::time_point(chrono::nanoseconds(time)));
+#endif
+}
+
+auto FramePacer::set_mode(PacerMode pacer_mode) -> void
+{
+    mode = pacer_mode;
+    deadline = 0; // Start pacing again from the current time
+}
+
+auto FramePacer::set_turbo_multiplier(u8 multiplier) -> void
+{
+    if (multiplier == 0)
+    {
+        throw runtime_error("Turbo multiplier must be at least 1");
+    }
+    turbo_multiplier = multiplier;
+}
+
+auto FramePacer::frame_period() const -> u64
+{
+    switch (mode)
+    {
+    case PacerMode::Normal:
+        return FRAME_NS;
+    case PacerMode::Turbo:
+        return FRAME_NS / turbo_multiplier;
+    case PacerMode::Unthrottled:
+        return 0;
+    default:
+        throw runtime_error("Unknown pacer mode at frame_period");
+    }
+}
+
+auto FramePacer::wait() -> void
+{
+    u64 period = frame_period();
+    u64 time = now();
+
+    if (period != 0)
+    {
+        deadline = (deadline == 0) ? time + period : deadline + period;
+
+        if (time >= deadline)
+        {
+            // A frame or more behind (pause, window drag), don't rush to catch up
+            if (time - deadline >= period)
+            {
+                deadline = time;
+            }
+            late_frames++;
+        }
+        else
+        {
+            if (deadline - time > SPIN_NS)
+            {
+                sleep_until(deadline - SPIN_NS);
+            }
+            while ((time = now()) < deadline)
+            {
+            }
+        }
+    }
+
+    record(time);
+}
+
+auto FramePacer::record(u64 time) -> void
+{
+    if (last_frame != 0)
+    {
+        u64 elapsed = time - last_frame;
+        frames++;
+        min_ns = min(min_ns, elapsed);
+        max_ns = max(max_ns, elapsed);
+        sum_ns += static_cast<double>(elapsed);
+        sum_sq_ns += static_cast<double>(elapsed) * static_cast<double>(elapsed);
+    }
+    last_frame = time;
+}
+
+auto FramePacer::report(ostream &out) const -> void
+{
+    if (frames == 0)
+    {
+        out << "frame pacer: no frames" << endl;
+        return;
+    }
+
+    double mean = sum_ns / static_cast<double>(frames);
+    double deviation = sqrt(max(0.0, sum_sq_ns / static_cast<double>(frames) - mean * mean));
+
+    out << "frame pacer: " << frames << " frames, " << 1e9 / mean << " fps (target "
+        << 1e9 / static_cast<double>(FRAME_NS) << ")" << endl;
+    out << "frame time ms: mean " << mean / 1e6 << ", stddev " << deviation / 1e6
+        << ", min " << static_cast<double>(min_ns) / 1e6 << ", max " << static_cast<double>(max_ns) / 1e6 << endl;
+    out << "late frames: " << late_frames << endl;
+}
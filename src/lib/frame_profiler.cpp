@@ -0,0 +1,74 @@
+#include "frame_profiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace
+{
+// Same order as FrameSection, then the whole frame
+constexpr const char *SECTION_NAMES[] = {"other", "cpu", "timer", "interrupts", "ppu", "present", "total"};
+} // namespace
+
+auto FrameProfiler::begin_frame() -> void
+{
+    frame_ticks.fill(0);
+    frame_start_ns = steady_ns();
+    frame_start_ticks = host_ticks();
+    section_start = frame_start_ticks;
+    in_frame = true;
+}
+
+auto FrameProfiler::end_frame() -> void
+{
+    if (!in_frame)
+    {
+        return;
+    }
+    charge();
+    in_frame = false;
+
+    // Ticks to ns from this frame's own wall time, the TSC rate is not known up front
+    u64 frame_ns = steady_ns() - frame_start_ns;
+    u64 total_ticks = max<u64>(section_start - frame_start_ticks, 1);
+    double ns_per_tick = static_cast<double>(frame_ns) / static_cast<double>(total_ticks);
+
+    for (size_t s = 0; s < SECTIONS; s++)
+    {
+        samples[s].push_back(static_cast<u32>(static_cast<double>(frame_ticks[s]) * ns_per_tick));
+    }
+    samples[SECTIONS].push_back(static_cast<u32>(frame_ns));
+
+    if (samples[SECTIONS].size() >= REPORT_FRAMES)
+    {
+        report(cout);
+    }
+}
+
+auto FrameProfiler::report(ostream &out) -> void
+{
+    static_assert(size(SECTION_NAMES) == SECTIONS + 1, "SECTION_NAMES is out of sync with FrameSection");
+
+    if (samples[SECTIONS].empty())
+    {
+        return;
+    }
+
+    ios::fmtflags format = out.flags();
+    out << "frame time ms over " << samples[SECTIONS].size() << " frames" << endl;
+    out << left << setw(12) << "" << setw(9) << "p50" << setw(9) << "p95" << setw(9) << "p99" << "max" << endl;
+    for (size_t s = 0; s < samples.size(); s++)
+    {
+        vector<u32> &values = samples[s];
+        sort(values.begin(), values.end());
+        auto percentile = [&](double p) -> double
+        {
+            size_t index = min(values.size() - 1, static_cast<size_t>(p * static_cast<double>(values.size())));
+            return values[index] / 1e6;
+        };
+
+        out << setw(12) << SECTION_NAMES[s] << fixed << setprecision(3) << setw(9) << percentile(0.50)
+            << setw(9) << percentile(0.95) << setw(9) << percentile(0.99) << values.back() / 1e6 << endl;
+        values.clear();
+    }
+    out.flags(format);
+}
@@ -1,12 +1,21 @@
 #include "gameboy.hpp"
 
-void keyboard(GameBoy *gb)
+// Host key of each joypad button, indexed by Button
+static const array<SDL_Keycode, 8> BUTTON_KEYS = {
+    SDLK_RIGHT, SDLK_LEFT, SDLK_UP, SDLK_DOWN, SDLK_x, SDLK_z, SDLK_BACKSPACE, SDLK_RETURN,
+};
+
+void keyboard(GameBoy *gb, Joypad *joypad, u64 cycle)
 {
     SDL_Event event;
 
     while (SDL_PollEvent(&event))
     {
-        if (event.type == SDL_KEYDOWN)
+        if (event.type == SDL_QUIT)
+        {
+            gb->state = QUIT;
+        }
+        else if (event.type == SDL_KEYDOWN)
         {
             switch (event.key.keysym.sym)
             {
@@ -14,18 +23,46 @@ void keyboard(GameBoy *gb)
                     gb->state = QUIT;
                     break;
 
-                case SDL_QUIT:
-                    gb->state = QUIT;
-                    break;
-
                 case SDLK_SPACE:
                     if (gb->state == PAUSED) gb->state = RUNNING;
                     else gb->state = PAUSED;
                     break;
 
+                case SDLK_TAB:
+                    gb->turbo = true;
+                    break;
+
+                case SDLK_F1:
+                    if (!event.key.repeat) gb->overlay = !gb->overlay;
+                    break;
+
+                case SDLK_F5:
+                    if (!event.key.repeat) gb->save_state = true;
+                    break;
+
+                case SDLK_F9:
+                    if (!event.key.repeat) gb->load_state = true;
+                    break;
+
                 default:
                     break;
             }
         }
+        else if (event.type == SDL_KEYUP && event.key.keysym.sym == SDLK_TAB)
+        {
+            gb->turbo = false;
+        }
+
+        // Buttons change at the polling cycle, the same input replays the same way
+        if ((event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) && !event.key.repeat)
+        {
+            for (u8 i = 0; i < BUTTON_KEYS.size(); i++)
+            {
+                if (event.key.keysym.sym == BUTTON_KEYS[i])
+                {
+                    joypad->push({cycle, static_cast<Button>(i), event.type == SDL_KEYDOWN});
+                }
+            }
+        }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,187 @@
+#include "guest_profiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <set>
+
+GuestProfiler::GuestProfiler(u32 sample_period) : period(sample_period)
+{
+    if (period == 0)
+    {
+        throw runtime_error("Guest profiler period must be at least 1 M-cycle");
+    }
+    stack.reserve(MAX_DEPTH);
+}
+
+auto GuestProfiler::load_symbols(const string &path) -> void
+{
+    ifstream file(path);
+    if (!file.is_open())
+    {
+        throw runtime_error("Failed to open symbol file '" + path + "'");
+    }
+
+    // RGBDS: "BB:AAAA Label" per line, ';' starts a comment
+    string line;
+    while (getline(file, line))
+    {
+        line = line.substr(0, line.find(';'));
+        istringstream fields(line);
+        string location;
+        string label;
+        if (!(fields >> location >> label))
+        {
+            continue;
+        }
+
+        size_t colon = location.find(':');
+        if (colon == string::npos)
+        {
+            continue;
+        }
+        u32 bank = static_cast<u32>(stoul(location.substr(0, colon), nullptr, 16));
+        u16 address = static_cast<u16>(stoul(location.substr(colon + 1), nullptr, 16));
+
+        // Only switchable ROM is told apart by bank, like banked() does
+        u32 key = (address >= 0x4000 && address < 0x8000) ? (bank << 16) | address : address;
+        symbols[key] = label;
+    }
+}
+
+auto GuestProfiler::name(u32 address) const -> string
+{
+    auto it = symbols.upper_bound(address);
+    if (it != symbols.begin() && (prev(it)->first >> 16) == (address >> 16))
+    {
+        --it;
+        u32 offset = address - it->first;
+        if (offset == 0)
+        {
+            return it->second;
+        }
+
+        ostringstream out;
+        out << it->second << "+0x" << hex << uppercase << offset;
+        return out.str();
+    }
+
+    ostringstream out;
+    out << hex << uppercase << setfill('0') << setw(2) << (address >> 16) << ':' << setw(4) << (address & 0xFFFF);
+    return out.str();
+}
+
+auto GuestProfiler::routine(u32 address) const -> string
+{
+    string label = name(address);
+    return label.substr(0, min(label.find('+'), label.find('.')));
+}
+
+auto GuestProfiler::enter(u16 target, u16 sp) -> void
+{
+    // Deep recursion or a stack switch, keep the innermost frames
+    if (stack.size() == MAX_DEPTH)
+    {
+        stack.erase(stack.begin());
+    }
+    stack.push_back({banked(target), sp});
+}
+
+auto GuestProfiler::leave(u16 sp) -> void
+{
+    // Frames whose return address is now above SP are gone, even if the routine popped it by hand
+    while (!stack.empty() && stack.back().sp < sp)
+    {
+        stack.pop_back();
+    }
+}
+
+auto GuestProfiler::sample(u16 pc, u64 weight) -> void
+{
+    u32 location = banked(pc);
+    flat[location] += weight;
+    total += weight;
+
+    vector<u32> key;
+    key.reserve(stack.size() + 1);
+    for (const Frame &frame : stack)
+    {
+        key.push_back(frame.entry);
+    }
+    key.push_back(location);
+    stacks[key] += weight;
+}
+
+auto GuestProfiler::write(const string &path) const -> void
+{
+    ofstream out(path, ios::trunc);
+    ofstream folded(path + ".folded", ios::trunc);
+    if (!out.is_open() || !folded.is_open())
+    {
+        throw runtime_error("Failed to open guest profile '" + path + "'");
+    }
+
+    // Self samples by routine, inclusive once per sample however deep the recursion
+    map<string, u64> self;
+    map<string, u64> inclusive;
+    map<string, u64> folded_counts;
+    for (const auto &[key, count] : stacks)
+    {
+        string leaf = routine(key.back());
+        self[leaf] += count;
+
+        set<string> seen;
+        string line;
+        for (size_t i = 0; i < key.size(); i++)
+        {
+            string frame = routine(key[i]);
+            if (seen.insert(frame).second)
+            {
+                inclusive[frame] += count;
+            }
+
+            // The leaf is usually the routine the last frame entered
+            if (i + 1 == key.size() && i > 0 && frame == routine(key[i - 1]))
+            {
+                break;
+            }
+            line += (line.empty() ? "" : ";") + frame;
+        }
+        folded_counts[line] += count;
+    }
+
+    for (const auto &[line, count] : folded_counts)
+    {
+        folded << line << ' ' << count << '\n';
+    }
+
+    auto percent = [&](u64 count) -> double
+    { return total ? 100.0 * static_cast<double>(count) / static_cast<double>(total) : 0.0; };
+
+    vector<pair<string, u64>> routines(self.begin(), self.end());
+    sort(routines.begin(), routines.end(), [](const auto &a, const auto &b)
+         { return a.second > b.second; });
+
+    out << "guest profile: " << total << " samples, one every " << period << " M-cycles" << endl;
+    out << left << fixed << setprecision(2) << setw(10) << "self %" << setw(12) << "self" << setw(10) << "incl %"
+        << setw(12) << "incl" << "routine" << endl;
+    for (const auto &[routine_name, count] : routines)
+    {
+        u64 incl = inclusive.at(routine_name);
+        out << setw(10) << percent(count) << setw(12) << count << setw(10) << percent(incl) << setw(12) << incl
+            << routine_name << endl;
+    }
+
+    // Hottest single addresses, loop bodies show up here
+    vector<pair<u32, u64>> addresses(flat.begin(), flat.end());
+    sort(addresses.begin(), addresses.end(), [](const auto &a, const auto &b)
+         { return a.second > b.second; });
+    addresses.resize(min<size_t>(addresses.size(), 32));
+
+    out << endl << setw(10) << "%" << setw(12) << "samples" << "address" << endl;
+    for (const auto &[location, count] : addresses)
+    {
+        ostringstream where;
+        where << hex << uppercase << setfill('0') << setw(2) << (location >> 16) << ':' << setw(4) << (location & 0xFFFF);
+        out << setw(10) << percent(count) << setw(12) << count << where.str() << "  " << name(location) << endl;
+    }
+}
@@ -531,7 +531,7 @@ auto Instruction::byte_load(const Instruction &instruction) -> void
     {
         u8 offset = registers->read_next_byte();
         u16 address = 0xFF00 + offset;
-        registers->get_bus()->write_byte(address, offset);
+        registers->get_bus()->write_byte(address, value);
         break;
     }
     case LoadTarget::BCI:
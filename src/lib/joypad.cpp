@@ -0,0 +1,82 @@
+#include "joypad.hpp"
+
+Joypad::Joypad(Registers *regs_ptr) : registers(regs_ptr)
+{
+    if (!registers)
+    {
+        throw runtime_error("Null pointer provided to Joypad constructor");
+    }
+
+    p1 = &registers->get_bus()->get_memory(0xFF00);
+    update();
+}
+
+auto Joypad::push(const InputEvent &event) -> void
+{
+    if (!queue.empty() && event.cycle < queue.back().cycle)
+    {
+        throw runtime_error("Input event out of order at cycle " + to_string(event.cycle));
+    }
+
+    queue.push_back(event);
+    deadline = queue.front().cycle;
+}
+
+auto Joypad::sync(u64 now) -> void
+{
+    while (!queue.empty() && queue.front().cycle <= now)
+    {
+        const InputEvent &event = queue.front();
+        u8 bit = 1 << static_cast<u8>(event.button);
+        pressed = event.pressed ? (pressed | bit) : (pressed & ~bit);
+        queue.pop_front();
+
+        update();
+    }
+
+    deadline = queue.empty() ? ~0ull : queue.front().cycle;
+}
+
+auto Joypad::write(u8 value) -> void
+{
+    select = value & 0x30; // Only the select bits are writable
+    update();
+}
+
+auto Joypad::update() -> void
+{
+    // Selected groups pull their pressed lines low
+    u8 lines = 0x0F;
+    if (!(select & 0x10))
+    {
+        lines &= ~pressed & 0x0F;
+    }
+    if (!(select & 0x20))
+    {
+        lines &= ~(pressed >> 4);
+    }
+
+    // A line going from high to low requests the joypad interrupt
+    if (*p1 & ~lines & 0x0F)
+    {
+        registers->set_interrupt_flag(INTERRUPT_JOYPAD);
+    }
+
+    *p1 = 0xC0 | select | lines;
+}
+
+auto Joypad::save_state(StateWriter &out) const -> void
+{
+    out.put(pressed);
+    out.put(select);
+}
+
+auto Joypad::load_state(StateReader &in) -> void
+{
+    // Queued events belong to the cycles of the session they were polled in
+    in.get(pressed);
+    in.get(select);
+    queue.clear();
+    deadline = ~0ull;
+    update();
+}
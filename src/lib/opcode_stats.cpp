@@ -0,0 +1,107 @@
+#include "opcode_stats.hpp"
+
+#ifdef OPCODE_STATS
+
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+// Same order as InstructionType
+constexpr const char *TYPE_NAMES[] = {
+    "ADD", "ADC", "SUB", "SBC", "AND", "OR", "XOR", "CP", "INC", "DEC", "CCF", "SCF",
+    "RRA", "RLA", "RRCA", "RLCA", "CPL", "BIT", "ADDHL", "RES", "SET", "SRL", "RR", "RL",
+    "RRC", "RLC", "SRA", "SLA", "SWAP", "JP", "JR", "JPI", "LD", "PUSH", "POP", "CALL",
+    "RET", "NOP", "HALT", "STOP", "EI", "DI", "RST", "CB"};
+} // namespace
+
+auto OpcodeStats::report(ostream &out) const -> void
+{
+    static_assert(size(TYPE_NAMES) == TYPE_COUNT, "TYPE_NAMES is out of sync with InstructionType");
+
+    u64 total = accumulate(counts.begin(), counts.end(), u64{0});
+    if (total == 0)
+    {
+        out << "opcode stats: no instructions" << endl;
+        return;
+    }
+
+    auto type_of = [](size_t index) -> size_t
+    {
+        const Instruction *instruction = Instruction::from_byte(static_cast<u8>(index), index >= 256);
+        return static_cast<size_t>(instruction->get_inst_type());
+    };
+
+    // Opcodes by executions
+    vector<size_t> order;
+    for (size_t i = 0; i < counts.size(); i++)
+    {
+        if (counts[i] != 0)
+        {
+            order.push_back(i);
+        }
+    }
+    sort(order.begin(), order.end(), [&](size_t a, size_t b)
+         { return counts[a] > counts[b]; });
+
+    ios::fmtflags format = out.flags();
+    out << "opcode stats: " << total << " instructions" << endl;
+    out << left << setw(10) << "opcode" << setw(8) << "type" << setw(14) << "count" << setw(9) << "%"
+        << setw(14) << "M-cycles" << "avg" << endl;
+    for (size_t i : order)
+    {
+        ostringstream opcode;
+        opcode << (i >= 256 ? "CB " : "") << "0x" << hex << uppercase << setw(2) << setfill('0') << (i & 0xFF);
+        out << setw(10) << opcode.str() << setw(8) << TYPE_NAMES[type_of(i)] << setw(14) << counts[i]
+            << setw(9) << fixed << setprecision(3) << 100.0 * static_cast<double>(counts[i]) / static_cast<double>(total)
+            << setw(14) << cycles[i] << setprecision(2) << static_cast<double>(cycles[i]) / static_cast<double>(counts[i])
+            << endl;
+    }
+
+    out << "M-cycles per instruction:" << endl;
+    for (size_t c = 0; c < histogram.size(); c++)
+    {
+        if (histogram[c] != 0)
+        {
+            out << "  " << setw(4) << c << histogram[c] << endl;
+        }
+    }
+
+    // Sampled ticks scaled up by each type's share of executions
+    array<u64, TYPE_COUNT> type_counts = {};
+    for (size_t i = 0; i < counts.size(); i++)
+    {
+        if (counts[i] != 0)
+        {
+            type_counts[type_of(i)] += counts[i];
+        }
+    }
+
+    array<double, TYPE_COUNT> estimate = {};
+    vector<size_t> types;
+    for (size_t t = 0; t < TYPE_COUNT; t++)
+    {
+        if (type_samples[t] != 0)
+        {
+            estimate[t] = static_cast<double>(type_ticks[t]) / static_cast<double>(type_samples[t]) * static_cast<double>(type_counts[t]);
+            types.push_back(t);
+        }
+    }
+    sort(types.begin(), types.end(), [&](size_t a, size_t b)
+         { return estimate[a] > estimate[b]; });
+    double estimate_total = accumulate(estimate.begin(), estimate.end(), 0.0);
+
+    out << "host time by type (1 in " << SAMPLE_PERIOD << " sampled):" << endl;
+    out << setw(8) << "type" << setw(10) << "samples" << setw(14) << "ticks/instr" << "% of time" << endl;
+    for (size_t t : types)
+    {
+        out << setw(8) << TYPE_NAMES[t] << setw(10) << type_samples[t] << setw(14) << setprecision(1)
+            << static_cast<double>(type_ticks[t]) / static_cast<double>(type_samples[t])
+            << setprecision(2) << 100.0 * estimate[t] / estimate_total << endl;
+    }
+    out.flags(format);
+}
+
+#endif // OPCODE_STATS
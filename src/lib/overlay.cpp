@@ -0,0 +1,183 @@
+#include "overlay.hpp"
+#include "frame_pacer.hpp"
+#include "host_ticks.hpp"
+
+#include <iomanip>
+
+Overlay::Overlay(const string &font_path)
+{
+    if (TTF_Init() != 0)
+    {
+        throw runtime_error(string("TTF_Init failed: ") + TTF_GetError());
+    }
+
+    font = TTF_OpenFont(font_path.c_str(), FONT_SIZE);
+    if (!font)
+    {
+        TTF_Quit();
+        throw runtime_error("Failed to open overlay font '" + font_path + "': " + TTF_GetError());
+    }
+}
+
+Overlay::~Overlay()
+{
+    if (text_texture)
+    {
+        SDL_DestroyTexture(text_texture);
+    }
+    TTF_CloseFont(font);
+    TTF_Quit();
+}
+
+auto Overlay::find_font() -> string
+{
+    static const array<const char *, 6> CANDIDATES = {
+        "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+        "/usr/share/fonts/TTF/DejaVuSansMono.ttf",
+        "/usr/share/fonts/dejavu-sans-mono-fonts/DejaVuSansMono.ttf",
+        "/usr/share/fonts/truetype/liberation/LiberationMono-Regular.ttf",
+        "/System/Library/Fonts/Menlo.ttc",
+        "C:\\Windows\\Fonts\\consola.ttf",
+    };
+
+    for (const char *path : CANDIDATES)
+    {
+        if (ifstream(path).good())
+        {
+            return path;
+        }
+    }
+    return "";
+}
+
+auto Overlay::frame(const OverlayCounters &counters) -> void
+{
+    u64 now = steady_ns();
+    if (last_frame_ns != 0)
+    {
+        frame_times[graph_head] = static_cast<u32>(min<u64>(now - last_frame_ns, ~0u));
+        graph_head = (graph_head + 1) % GRAPH_FRAMES;
+    }
+    last_frame_ns = now;
+
+    if (window_start_ns == 0)
+    {
+        window_start = counters;
+        window_start_ns = now;
+        return;
+    }
+
+    u32 frames = counters.frames - window_start.frames;
+    if (frames < UPDATE_FRAMES)
+    {
+        return;
+    }
+
+    // Rounded to what is shown, so equal readings keep the cached texture
+    double seconds = static_cast<double>(now - window_start_ns) / 1e9;
+    double cycles = static_cast<double>(counters.cycles - window_start.cycles);
+    double speed = cycles / (seconds * 1'048'576.0) * 100.0; // 1.048576 MHz in M-cycles
+    double fps = frames / seconds;
+    double mips = static_cast<double>(counters.instructions - window_start.instructions) / seconds / 1e6;
+    double halted = (cycles > 0) ? static_cast<double>(counters.halted_cycles - window_start.halted_cycles) / cycles * 100.0 : 0.0;
+
+    ostringstream out;
+    out << fixed << setprecision(0) << "speed  " << speed << "%\n"
+        << setprecision(1) << "fps    " << fps << "\n"
+        << setprecision(2) << "mips   " << mips << "\n"
+        << setprecision(0) << "halted " << halted << "%\n"
+        << "skip   " << counters.skipped_frames - window_start.skipped_frames << "/" << frames;
+    text = out.str();
+
+    window_start = counters;
+    window_start_ns = now;
+}
+
+auto Overlay::refresh_texture(SDL_Renderer *renderer) -> void
+{
+    if (text == rendered_text && text_texture)
+    {
+        return;
+    }
+    rendered_text = text;
+
+    if (text_texture)
+    {
+        SDL_DestroyTexture(text_texture);
+        text_texture = nullptr;
+    }
+    if (text.empty())
+    {
+        return;
+    }
+
+    // Wrap length 0 breaks only at the newlines
+    SDL_Surface *surface = TTF_RenderUTF8_Blended_Wrapped(font, text.c_str(), SDL_Color{255, 255, 255, 255}, 0);
+    if (!surface)
+    {
+        SDL_Log("Failed to render overlay text: %s", TTF_GetError());
+        return;
+    }
+
+    text_texture = SDL_CreateTextureFromSurface(renderer, surface);
+    SDL_FreeSurface(surface);
+    if (!text_texture)
+    {
+        SDL_Log("Failed to create overlay texture: %s", SDL_GetError());
+        return;
+    }
+    SDL_QueryTexture(text_texture, nullptr, nullptr, &text_width, &text_height);
+}
+
+auto Overlay::draw(SDL_Renderer *renderer) -> void
+{
+    if (!visible)
+    {
+        return;
+    }
+    refresh_texture(renderer);
+
+    // Window pixels instead of the 160x144 logical size of the picture
+    int logical_width = 0;
+    int logical_height = 0;
+    int output_width = 0;
+    int output_height = 0;
+    SDL_RenderGetLogicalSize(renderer, &logical_width, &logical_height);
+    SDL_RenderSetLogicalSize(renderer, 0, 0);
+    SDL_GetRendererOutputSize(renderer, &output_width, &output_height);
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+
+    constexpr int MARGIN = 4;
+    if (text_texture)
+    {
+        SDL_Rect panel = {0, 0, text_width + MARGIN * 2, text_height + MARGIN * 2};
+        SDL_RenderFillRect(renderer, &panel);
+        SDL_Rect target = {MARGIN, MARGIN, text_width, text_height};
+        SDL_RenderCopy(renderer, text_texture, nullptr, &target);
+    }
+
+    // Frame times along the bottom, full height is two frame periods
+    constexpr int GRAPH_HEIGHT = 48;
+    int step = max(1, min(3, output_width / static_cast<int>(GRAPH_FRAMES)));
+    int bottom = output_height - MARGIN;
+    SDL_Rect graph = {0, bottom - GRAPH_HEIGHT - MARGIN, step * static_cast<int>(GRAPH_FRAMES) + MARGIN * 2, GRAPH_HEIGHT + MARGIN * 2};
+    SDL_RenderFillRect(renderer, &graph);
+
+    int target_y = bottom - GRAPH_HEIGHT / 2;
+    SDL_SetRenderDrawColor(renderer, 96, 96, 96, 255);
+    SDL_RenderDrawLine(renderer, MARGIN, target_y, MARGIN + step * static_cast<int>(GRAPH_FRAMES - 1), target_y);
+
+    array<SDL_Point, GRAPH_FRAMES> points;
+    for (size_t i = 0; i < GRAPH_FRAMES; i++)
+    {
+        u64 ns = min<u64>(frame_times[(graph_head + i) % GRAPH_FRAMES], FramePacer::FRAME_NS * 2);
+        points[i] = {MARGIN + static_cast<int>(i) * step, bottom - static_cast<int>(ns * GRAPH_HEIGHT / (FramePacer::FRAME_NS * 2))};
+    }
+    SDL_SetRenderDrawColor(renderer, 96, 255, 96, 255);
+    SDL_RenderDrawLines(renderer, points.data(), static_cast<int>(points.size()));
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_RenderSetLogicalSize(renderer, logical_width, logical_height);
+}
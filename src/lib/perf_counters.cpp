@@ -0,0 +1,145 @@
+#include "perf_counters.hpp"
+
+#include <iomanip>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+auto open_counter(u32 type, u64 config, int group) -> int
+{
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = (group == -1); // The group starts and stops with its leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+}
+} // namespace
+
+PerfCounters::PerfCounters()
+{
+    // Fails in containers and with perf_event_paranoid > 2, callers then report time only
+    fds[CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (fds[CYCLES] < 0)
+    {
+        return;
+    }
+
+    fds[INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, fds[CYCLES]);
+    if (fds[INSTRUCTIONS] < 0)
+    {
+        close(fds[CYCLES]);
+        fds[CYCLES] = -1;
+        return;
+    }
+
+    // Missing on some PMUs and most VMs, the group works without them
+    fds[BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, fds[CYCLES]);
+    fds[L1D_MISSES] = open_counter(PERF_TYPE_HW_CACHE,
+                                   PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+                                   fds[CYCLES]);
+}
+
+PerfCounters::~PerfCounters()
+{
+    // Members before the leader
+    for (size_t i = EVENT_COUNT; i-- > 0;)
+    {
+        if (fds[i] >= 0)
+        {
+            close(fds[i]);
+        }
+    }
+}
+
+auto PerfCounters::start() -> void
+{
+    if (!available())
+    {
+        return;
+    }
+    ioctl(fds[CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds[CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+auto PerfCounters::stop() -> PerfSample
+{
+    PerfSample sample;
+    if (!available())
+    {
+        return sample;
+    }
+    ioctl(fds[CYCLES], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // PERF_FORMAT_GROUP: event count, then one value per event in open order, skipped events leave no gap
+    array<u64, EVENT_COUNT + 1> values = {};
+    ssize_t bytes = read(fds[CYCLES], values.data(), sizeof(values));
+    if (bytes < static_cast<ssize_t>(sizeof(u64) * 3))
+    {
+        return sample;
+    }
+
+    array<u64, EVENT_COUNT> counts = {};
+    size_t next = 1;
+    for (size_t i = 0; i < EVENT_COUNT && next <= values[0]; i++)
+    {
+        if (fds[i] >= 0)
+        {
+            counts[i] = values[next++];
+        }
+    }
+    sample.cycles = counts[CYCLES];
+    sample.instructions = counts[INSTRUCTIONS];
+    sample.branch_misses = counts[BRANCH_MISSES];
+    sample.l1d_misses = counts[L1D_MISSES];
+    return sample;
+}
+
+#else
+
+PerfCounters::PerfCounters() {}
+
+PerfCounters::~PerfCounters() {}
+
+auto PerfCounters::start() -> void {}
+
+auto PerfCounters::stop() -> PerfSample { return {}; }
+
+#endif
+
+auto PerfCounters::report(ostream &out, const PerfSample &sample, u64 guest_instructions) const -> void
+{
+    if (!available())
+    {
+        out << "(hardware counters unavailable, time only)" << endl;
+        return;
+    }
+
+    // Caller's stream formatting is put back at the end
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    double guest = static_cast<double>(max<u64>(guest_instructions, 1));
+    out << fixed << setprecision(2);
+    out << "host cycles/guest instruction: " << static_cast<double>(sample.cycles) / guest << endl;
+    out << "host instructions/guest instruction: " << static_cast<double>(sample.instructions) / guest << endl;
+    out << "host IPC: " << static_cast<double>(sample.instructions) / static_cast<double>(max<u64>(sample.cycles, 1)) << endl;
+    if (has_branch_misses())
+    {
+        out << "branch misses/1000 guest instructions: " << static_cast<double>(sample.branch_misses) * 1000.0 / guest << endl;
+    }
+    if (has_l1d_misses())
+    {
+        out << "L1D misses/1000 guest instructions: " << static_cast<double>(sample.l1d_misses) * 1000.0 / guest << endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -1,14 +1,20 @@
 #include "ppu.hpp"
+#include "tracer.hpp"
 
-PPU::PPU(MemoryBus *bus_ptr, Registers *regs_ptr) : bus(bus_ptr), registers(regs_ptr)
+PPU::PPU(MemoryBus *bus_ptr, Registers *regs_ptr, bool headless_mode)
+    : headless(headless_mode), bus(bus_ptr), registers(regs_ptr)
 {
     if (!bus || !registers)
     {
         throw runtime_error("Null pointer provided to PPU constructor");
     }
 
-    // Intialization of SDL2
-    init();
+    // Intialization of SDL2, headless runs never open a window
+    if (!headless)
+    {
+        init();
+    }
+    bus->write_byte(0xFF41, 0x80);
 
     // Set vars
     control = &bus->get_memory(0xFF40);
@@ -17,6 +23,8 @@ PPU::PPU(MemoryBus *bus_ptr, Registers *regs_ptr) : bus(bus_ptr), registers(regs
     scx = &bus->get_memory(0xFF43);
     ly = &bus->get_memory(0xFF44);
     lyc = &bus->get_memory(0xFF45);
+    wy = &bus->get_memory(0xFF4A);
+    wx = &bus->get_memory(0xFF4B);
     interrupt_flag = &bus->get_memory(0xFF0F);
 
     // Setup palettes
@@ -27,7 +35,7 @@ PPU::PPU(MemoryBus *bus_ptr, Registers *regs_ptr) : bus(bus_ptr), registers(regs
     bus->tiles.fill(array<array<u8, 8>, 8>{});
 
     // Setup frame buffer
-    fill(frame_buffer.begin(), frame_buffer.end(), Colour{255, 255, 255});
+    frame_buffer.assign(SCREEN_WIDTH * SCREEN_HEIGHT, Colour{255, 255, 255});
 };
 
 auto PPU::init() -> void
@@ -78,7 +86,7 @@ auto PPU::init() -> void
     SDL_SetWindowResizable(window, SDL_TRUE);
 
     texture = SDL_CreateTexture(renderer,
-                                SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING,
                                 SCREEN_WIDTH, SCREEN_HEIGHT);
 
     if (!texture)
@@ -89,115 +97,238 @@ auto PPU::init() -> void
         SDL_Quit();
         return;
     }
+}
 
-    bus->write_byte(0xFF41, 0x80);
+auto PPU::set_frame_skip(u8 skip, u8 period) -> void
+{
+    if (period == 0 || skip >= period)
+    {
+        throw runtime_error("Invalid frame skip: " + to_string(skip) + "/" + to_string(period));
+    }
+
+    frame_skip = skip;
+    frame_period = period;
 }
 
-auto PPU::draw_scanline() -> void
+auto PPU::set_render_thread(bool enabled) -> void
 {
-    if (*ly >= 144)
+    if (enabled && !render_thread)
     {
-        return;
+        render_thread = make_unique<RenderThread>([this](const LineSignature &line)
+                                                  { render_line(line); });
+
+        // Queued lines read VRAM/OAM, let them finish before it changes
+        bus->video_write_barrier = [this]()
+        { render_thread->drain(); };
+    }
+    else if (!enabled && render_thread)
+    {
+        bus->video_write_barrier = nullptr;
+        render_thread.reset();
     }
+}
 
-    u8 scanline_row[160] = {0};
+auto PPU::enable_overlay(const string &font_path) -> void
+{
+    if (!headless)
+    {
+        overlay = make_unique<Overlay>(font_path);
+    }
+}
 
-    u16 map_offset = *control & 0x08 ? 0x1C00 : 0x1800;
-    map_offset += (((*ly + *scy) & 0xFF) >> 3) << 5;
+auto PPU::set_filter(ScaleFilter scale_filter) -> void
+{
+    filter = scale_filter;
+    if (filter != ScaleFilter::None && !upscaler)
+    {
+        u8 threads = static_cast<u8>(clamp(thread::hardware_concurrency(), 1u, 4u));
+        scale_pool = make_unique<ThreadPool>(threads);
+        upscaler = make_unique<Upscaler>(scale_pool.get());
+    }
 
-    u8 line_offset = *scx >> 3;
-    u8 x = *scx & 0x07;
-    u8 y = (*ly + *scy) & 0x07;
-    u16 pixel_offset = *ly * 160;
+    // Filtered pixels only line up with the screen at whole multiples
+    if (!headless && SDL_RenderSetIntegerScale(renderer, filter != ScaleFilter::None ? SDL_TRUE : SDL_FALSE) != 0)
+    {
+        SDL_Log("Failed to set integer scale: %s", SDL_GetError());
+    }
+}
 
-    u8 tile = bus->read_byte(map_offset + line_offset + 0x8000);
+auto PPU::parse_frame_format(const string &name) -> FrameFormat
+{
+    if (name == "rgb")
+    {
+        return FrameFormat::Rgb;
+    }
+    if (name == "indexed")
+    {
+        return FrameFormat::Indexed;
+    }
+    if (name == "packed")
+    {
+        return FrameFormat::Packed;
+    }
+    throw runtime_error("Unknown frame format: " + name + " (rgb, indexed, packed)");
+}
 
-    // Background
-    for (u8 i = 0; i < 160; i++)
+auto PPU::set_frame_format(FrameFormat format) -> void
+{
+    if (render_thread)
     {
-        if (tile >= bus->tiles.size())
-        {
-            break;
-        }
+        render_thread->drain();
+    }
 
-        u8 colour = bus->tiles[tile][y][x];
-        scanline_row[i] = colour;
+    frame_format = format;
+    switch (format)
+    {
+    case FrameFormat::Rgb:
+        frame_buffer.assign(SCREEN_WIDTH * SCREEN_HEIGHT, Colour{255, 255, 255});
+        vector<u8>().swap(shade_buffer);
+        break;
+    case FrameFormat::Indexed:
+        shade_buffer.assign(SCREEN_WIDTH * SCREEN_HEIGHT, 0);
+        vector<Colour>().swap(frame_buffer);
+        break;
+    case FrameFormat::Packed:
+        shade_buffer.assign(SCREEN_WIDTH * SCREEN_HEIGHT / 4, 0);
+        vector<Colour>().swap(frame_buffer);
+        break;
+    default:
+        throw runtime_error("Unknown frame format at set_frame_format");
+    }
+    vector<Colour>().swap(rgb_buffer);
 
-        if (pixel_offset < frame_buffer.size() && colour < 4)
-        {
-            frame_buffer[pixel_offset].r = bus->palette_BGP[colour].r;
-            frame_buffer[pixel_offset].g = bus->palette_BGP[colour].g;
-            frame_buffer[pixel_offset].b = bus->palette_BGP[colour].b;
-        }
+    // Nothing of the old buffer survives, every line renders again
+    line_signatures.fill(LineSignature{});
+    frame_changed = true;
+}
 
-        x++;
-        if (x == 8)
-        {
-            x = 0;
-            line_offset = (line_offset + 1) & 0x1F;
-            tile = bus->read_byte(map_offset + line_offset + 0x8000);
-        }
+auto PPU::draw_scanline() -> void
+{
+    if (*ly >= SCREEN_HEIGHT || !render_enabled)
+    {
+        return;
+    }
 
-        pixel_offset++;
+    TraceScope scope("scanline", "ppu", "ly", *ly);
+
+    if (bus->tiles_stale)
+    {
+        bus->decode_tiles();
     }
 
-    // Sprite
-    for (u8 i = 0; i < 40; i++)
+    ScanlineRegs regs{*ly, *scx, *scy, *control, *wx, *wy, window_line};
+    if (Compositor::window_visible(regs))
     {
-        Sprite sprite; // Each sprite is 4 bytes long
-        sprite.y = bus->read_byte(0xFE00 + i * 4);
-        sprite.x = bus->read_byte(0xFE01 + i * 4);
-        sprite.tile = bus->read_byte(0xFE02 + i * 4);
-        sprite.options.flags = bus->read_byte(0xFE03 + i * 4);
+        window_line++;
+    }
 
-        u8 sprite_y = sprite.y - 16;
-        u8 sprite_x = sprite.x - 8;
+    // Same inputs as the previous frame, the old pixels are still valid
+    LineSignature signature{bus->vram_generation, bus->oam_generation, regs,
+                            bus->peek(0xFF47), bus->peek(0xFF48), bus->peek(0xFF49), true};
+    if (signature == line_signatures[regs.ly])
+    {
+        return;
+    }
+    line_signatures[regs.ly] = signature;
+    frame_changed = true;
 
-        if (sprite_y <= *ly && (sprite_y + 8) > *ly)
-        {
-            Colour *palette = &bus->palette_sprite[sprite.options.bits.palette][0];
-            pixel_offset = *ly * 160 + sprite_x;
+    if (render_thread)
+    {
+        render_thread->push(signature);
+    }
+    else
+    {
+        render_line(signature);
+    }
+}
 
-            u8 tile_row = 0;
-            if (sprite.options.bits.vFlip)
-            {
-                tile_row = 7 - *ly - sprite_y;
-            }
-            else
-            {
-                tile_row = *ly - sprite_y;
-            }
+auto PPU::render_line(const LineSignature &line) -> void
+{
+    TraceScope scope("render line", "ppu", "ly", line.regs.ly);
+    background.refresh(*bus, line.regs.lcdc);
 
-            for (x = 0; x < 8; x++)
-            {
-                if (sprite_x + x >= 0 && sprite_x + x < 160 &&
-                    (~sprite.options.bits.render_priority || !scanline_row[sprite_x + x]))
-                {
-                    u8 colour;
-                    if (sprite.options.bits.hFlip)
-                    {
-                        colour = bus->tiles[sprite.tile][tile_row][7 - x];
-                    }
-                    else
-                    {
-                        colour = bus->tiles[sprite.tile][tile_row][x];
-                    }
-
-                    if (colour && colour < 4)
-                    {
-                        frame_buffer[pixel_offset].r = palette[colour].r;
-                        frame_buffer[pixel_offset].g = palette[colour].g;
-                        frame_buffer[pixel_offset].b = palette[colour].b;
-                    }
-                    pixel_offset++;
-                }
-            }
+    PaletteLUT lut = Compositor::build_lut(line.bgp, line.obp0, line.obp1);
+    switch (frame_format)
+    {
+    case FrameFormat::Rgb:
+        Compositor::compose(*bus, background, line.regs, lut, &frame_buffer[line.regs.ly * SCREEN_WIDTH]);
+        break;
+    case FrameFormat::Indexed:
+        Compositor::compose_shades(*bus, background, line.regs, lut, &shade_buffer[line.regs.ly * SCREEN_WIDTH]);
+        break;
+    case FrameFormat::Packed:
+    {
+        alignas(16) array<u8, SCREEN_WIDTH> shades;
+        Compositor::compose_shades(*bus, background, line.regs, lut, shades.data());
+        Compositor::pack_shades(shades.data(), &shade_buffer[line.regs.ly * SCREEN_WIDTH / 4]);
+        break;
+    }
+    default:
+        throw runtime_error("Unknown frame format at render_line");
+    }
+}
+
+auto PPU::convert_frame() -> const Colour *
+{
+    if (frame_format == FrameFormat::Rgb)
+    {
+        return frame_buffer.data();
+    }
+
+    rgb_buffer.resize(SCREEN_WIDTH * SCREEN_HEIGHT);
+    for (u8 y = 0; y < SCREEN_HEIGHT; y++)
+    {
+        // A packed buffer is a quarter the size, indexing it by whole rows would run off the end
+        alignas(16) array<u8, SCREEN_WIDTH> unpacked;
+        const u8 *shades = unpacked.data();
+        if (frame_format == FrameFormat::Packed)
+        {
+            Compositor::unpack_shades(&shade_buffer[y * SCREEN_WIDTH / 4], unpacked.data());
         }
+        else
+        {
+            shades = &shade_buffer[y * SCREEN_WIDTH];
+        }
+        Compositor::shades_to_rgb(shades, &rgb_buffer[y * SCREEN_WIDTH]);
+    }
+    return rgb_buffer.data();
+}
+
+auto PPU::capture_frame() -> vector<Colour>
+{
+    if (render_thread)
+    {
+        render_thread->drain();
     }
+
+    const Colour *frame = convert_frame();
+    return vector<Colour>(frame, frame + SCREEN_WIDTH * SCREEN_HEIGHT);
 }
 
 auto PPU::draw_frame() -> void
 {
+    // Nothing changed since the last present, a visible overlay updates every frame
+    bool overlay_visible = overlay && overlay->is_visible();
+    if (headless && render_thread)
+    {
+        // Nothing is presented, but the queue only holds one frame of lines
+        render_thread->drain();
+    }
+    if ((!frame_changed && !overlay_visible) || headless)
+    {
+        return;
+    }
+    frame_changed = false;
+
+    ProfileScope scope(profiler, FrameSection::Present);
+    TraceScope trace("present", "present");
+
+    if (render_thread)
+    {
+        TraceScope drain("render drain", "present");
+        render_thread->drain();
+    }
+
     if (SDL_SetTextureColorMod(texture, 255, 255, 255) != 0)
     {
         SDL_Log("Failed to set texture color mod: %s", SDL_GetError());
@@ -216,44 +347,152 @@ auto PPU::draw_frame() -> void
         SDL_Quit();
     }
 
-    if (SDL_SetRenderTarget(renderer, texture) != 0)
+    const Colour *frame = convert_frame();
+    SDL_Texture *source = texture;
+    if (filter == ScaleFilter::None)
+    {
+        if (SDL_UpdateTexture(texture, nullptr, frame, SCREEN_WIDTH * 3) != 0)
+        {
+            SDL_Log("Failed to update texture: %s", SDL_GetError());
+            SDL_Quit();
+        }
+    }
+    else
+    {
+        source = upload_scaled(frame);
+    }
+
+    if (SDL_RenderCopy(renderer, source, nullptr, &texture_rect) != 0)
     {
-        SDL_Log("Failed to set render target: %s", SDL_GetError());
+        SDL_Log("Failed to render copy: %s", SDL_GetError());
         SDL_Quit();
     }
 
-    if (SDL_UpdateTexture(texture, nullptr, frame_buffer.data(), SCREEN_WIDTH * 3) != 0)
+    if (overlay_visible)
     {
-        SDL_Log("Failed to update texture: %s", SDL_GetError());
+        overlay->draw(renderer);
+    }
+
+    SDL_RenderPresent(renderer);
+}
+
+auto PPU::upload_scaled(const Colour *frame) -> SDL_Texture *
+{
+    int output_w = 0;
+    int output_h = 0;
+    if (SDL_GetRendererOutputSize(renderer, &output_w, &output_h) != 0)
+    {
+        SDL_Log("Failed to get renderer output size: %s", SDL_GetError());
         SDL_Quit();
     }
 
-    if (SDL_RenderCopy(renderer, texture, nullptr, &texture_rect) != 0)
+    // Largest multiple the window fits, capped to keep the texture reasonable
+    u8 fit = static_cast<u8>(clamp(min(output_w / SCREEN_WIDTH, output_h / SCREEN_HEIGHT), 1, 12));
+    u8 factor = Upscaler::fit_factor(filter, fit);
+
+    if (!scaled_texture || factor != scaled_factor)
     {
-        SDL_Log("Failed to render copy: %s", SDL_GetError());
+        if (scaled_texture)
+        {
+            SDL_DestroyTexture(scaled_texture);
+        }
+        scaled_texture = SDL_CreateTexture(renderer,
+                                           SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING,
+                                           SCREEN_WIDTH * factor, SCREEN_HEIGHT * factor);
+        if (!scaled_texture)
+        {
+            SDL_Log("Failed to create scaled texture: %s", SDL_GetError());
+            SDL_Quit();
+        }
+        scaled_factor = factor;
+    }
+
+    void *pixels = nullptr;
+    int pitch = 0;
+    if (SDL_LockTexture(scaled_texture, nullptr, &pixels, &pitch) != 0)
+    {
+        SDL_Log("Failed to lock scaled texture: %s", SDL_GetError());
         SDL_Quit();
     }
 
-    SDL_RenderPresent(renderer);
+    upscaler->run(filter, factor, frame, static_cast<u32 *>(pixels), static_cast<u32>(pitch) / sizeof(u32));
+    SDL_UnlockTexture(scaled_texture);
+
+    return scaled_texture;
 }
 
-auto PPU::step(u8 cycle) -> void
+auto PPU::catch_up(u64 now) -> void
 {
-    // TODO: Delete later
-    *ly = 0x8F; // TODO: Delete later
-    // TODO: Delete later
+    if (now > synced_cycle)
+    {
+        step(static_cast<u16>(now - synced_cycle));
+        synced_cycle = now;
+    }
 
-    ppu_cycle += cycle;
+    // The access may change STAT/LYC, plan again once the instruction is done
+    deadline = now;
+}
+
+auto PPU::sync(u64 now) -> void
+{
+    catch_up(now);
+    deadline = synced_cycle + cycles_to_next_interrupt();
+}
 
-    // Delete it later
-    (*ly)++;
+auto PPU::cycles_to_next_interrupt() const -> u16
+{
+    // Position in the frame, lines run OAM scan, pixel transfer, H-Blank
+    u16 line_cycle = ppu_cycle;
+    if (mode == 3)
+    {
+        line_cycle += MODE_CYCLES[2];
+    }
+    else if (mode == 0)
+    {
+        line_cycle += MODE_CYCLES[2] + MODE_CYCLES[3];
+    }
+    const u16 h_blank = MODE_CYCLES[2] + MODE_CYCLES[3];
+    const u16 frame = WRAP_LINE * LINE_CYCLES;
+    const u16 position = *ly * LINE_CYCLES + line_cycle;
+
+    auto until = [&](u16 event) -> u16
+    { return (event > position) ? event - position : event + frame - position; };
+
+    // V-Blank always fires and presents the frame
+    u16 next = until(SCREEN_HEIGHT * LINE_CYCLES);
+
+    if (*stat & 0x08) // H-Blank of this or the next visible line
+    {
+        u16 line = (line_cycle < h_blank) ? *ly : *ly + 1;
+        next = min(next, until((line < SCREEN_HEIGHT) ? line * LINE_CYCLES + h_blank : h_blank));
+    }
+
+    if (*stat & 0x20) // OAM scan of the next visible line
+    {
+        u16 line = *ly + 1;
+        next = min(next, until((line < SCREEN_HEIGHT) ? line * LINE_CYCLES : 0));
+    }
 
-    switch (mode)
+    if ((*stat & 0x40) && *lyc >= 1 && *lyc <= WRAP_LINE) // LY is compared as it increments
     {
-    case 0: // H-Blank
-        if (ppu_cycle >= 51)
+        next = min(next, until(*lyc * LINE_CYCLES));
+    }
+
+    return next;
+}
+
+auto PPU::step(u16 cycle) -> void
+{
+    ppu_cycle += cycle;
+
+    // Catch up on every mode transition covered by the elapsed cycles
+    while (ppu_cycle >= MODE_CYCLES[mode])
+    {
+        ppu_cycle -= MODE_CYCLES[mode];
+
+        switch (mode)
         {
-            ppu_cycle -= 51;
+        case 0: // H-Blank
             mode = 2;
 
             (*ly)++;
@@ -277,14 +516,9 @@ auto PPU::step(u8 cycle) -> void
 
             // Update mode in STAT register
             *stat = (*stat & 0xFC) | (mode & 3);
-        }
-        break;
-
-    case 1: // V-Blank
-        if (ppu_cycle >= 114)
-        {
-            ppu_cycle -= 114;
+            break;
 
+        case 1: // V-Blank
             (*ly)++;
             compare_ly_lyc();
 
@@ -293,6 +527,12 @@ auto PPU::step(u8 cycle) -> void
                 *ly = 0;
                 mode = 2;
 
+                // New frame, only host rendering depends on the skip pattern
+                frame_count++;
+                render_enabled = (frame_count % frame_period) >= frame_skip;
+                skipped_frames += render_enabled ? 0 : 1;
+                window_line = 0;
+
                 // Update mode in STAT register
                 *stat = (*stat & 0xFC) | (mode & 3);
 
@@ -301,24 +541,16 @@ auto PPU::step(u8 cycle) -> void
                     registers->set_interrupt_flag(INTERRUPT_LCD);
                 }
             }
-        }
-        break;
+            break;
 
-    case 2: // OAM (Object Attribute Memory)
-        if (ppu_cycle >= 20)
-        {
-            ppu_cycle -= 20;
+        case 2: // OAM (Object Attribute Memory)
             mode = 3;
 
             // Update mode in STAT register
             *stat = (*stat & 0xFC) | (mode & 3);
-        }
-        break;
+            break;
 
-    case 3: // V-RAM (Video RAM)
-        if (ppu_cycle >= 43)
-        {
-            ppu_cycle -= 43;
+        case 3: // V-RAM (Video RAM)
             mode = 0;
 
             // Render the current scanline
@@ -331,26 +563,29 @@ auto PPU::step(u8 cycle) -> void
             {
                 registers->set_interrupt_flag(INTERRUPT_LCD);
             }
-        }
-        break;
+            break;
 
-    default:
-        throw runtime_error("Unknown mode at ppu step: " + to_string(static_cast<u16>(mode)));
-        break;
-    }
+        default:
+            throw runtime_error("Unknown mode at ppu step: " + to_string(static_cast<u16>(mode)));
+            break;
+        }
 
-    // Frame rendering
-    if (frame_drawn_flag)
-    {
-        draw_frame();
-        frame_drawn_flag = false;
+        // Frame rendering
+        if (frame_drawn_flag)
+        {
+            if (render_enabled)
+            {
+                draw_frame();
+            }
+            frame_drawn_flag = false;
+        }
     }
 }
 
 auto PPU::compare_ly_lyc() -> void
 {
     *stat = (*stat & ~0x04) | ((*lyc == *ly) ? 0x04 : 0x00);
-    if (*lyc == *ly && (*stat & 0x04))
+    if (*lyc == *ly && (*stat & 0x40)) // Bit 6 enables LYC interrupt
     {
         registers->set_interrupt_flag(INTERRUPT_LCD);
     }
@@ -358,8 +593,49 @@ auto PPU::compare_ly_lyc() -> void
 
 auto PPU::quit() -> void
 {
+    if (headless)
+    {
+        return;
+    }
+
+    overlay.reset();
+    if (scaled_texture)
+    {
+        SDL_DestroyTexture(scaled_texture);
+    }
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
+}
+
+auto PPU::save_state(StateWriter &out) const -> void
+{
+    out.put(ppu_cycle);
+    out.put(synced_cycle);
+    out.put(deadline);
+    out.put(mode);
+    out.put(window_line);
+    out.put(frame_count);
+    out.put(frame_drawn_flag);
+}
+
+auto PPU::load_state(StateReader &in) -> void
+{
+    if (render_thread)
+    {
+        render_thread->drain();
+    }
+
+    in.get(ppu_cycle);
+    in.get(synced_cycle);
+    in.get(deadline);
+    in.get(mode);
+    in.get(window_line);
+    in.get(frame_count);
+    in.get(frame_drawn_flag);
+
+    background.invalidate();
+    line_signatures.fill(LineSignature{});
+    frame_changed = true;
 }
\ No newline at end of file
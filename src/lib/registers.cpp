@@ -271,6 +271,7 @@ auto Registers::get_IME() -> u8
 auto Registers::set_IME(u8 value) -> void
 {
     IME = value;
+    update_interrupt_pending();
 }
 
 auto Registers::get_is_halted() -> u8
@@ -281,30 +282,34 @@ auto Registers::get_is_halted() -> u8
 auto Registers::set_is_halted(u8 value) -> void
 {
     is_halted = value;
+    update_interrupt_pending();
 }
 
 auto Registers::set_interrupt_flag(u8 flag) -> void
 {
-    u8 IF_value = get_bus()->read_byte(0xFF0F);
-    IF_value |= flag;
-    return get_bus()->write_byte(0xFF0F, IF_value);
+    *interrupt_flag |= flag;
+    update_interrupt_pending();
 }
 
 auto Registers::unset_interrupt_flag(u8 flag) -> void
 {
-    u8 IF_value = get_bus()->read_byte(0xFF0F);
-    IF_value &= ~flag;
-    return get_bus()->write_byte(0xFF0F, IF_value);
+    *interrupt_flag &= ~flag;
+    update_interrupt_pending();
 }
 
 auto Registers::is_interrupt_enabled(u8 flag) -> u8
 {
-    return get_bus()->read_byte(0xFFFF) & flag;
+    return *interrupt_enable & flag;
 }
 
 auto Registers::is_interrupt_flag_set(u8 flag) -> u8
 {
-    return get_bus()->read_byte(0xFF0F) & flag;
+    return *interrupt_flag & flag;
+}
+
+auto Registers::update_interrupt_pending() -> void
+{
+    interrupt_pending = requested_interrupts() && (IME || is_halted);
 }
 
 auto Registers::trigger_interrupt(u8 flag, u8 value) -> void
@@ -314,15 +319,43 @@ auto Registers::trigger_interrupt(u8 flag, u8 value) -> void
     get_bus()->write_byte(SP, static_cast<u8>(PC & 0x00FF));
     get_bus()->write_byte(SP + 1, static_cast<u8>((PC & 0xFF00) >> 8));
 
-    // Set PC to (V-Blank/LCD/Timer Overflow/Joypad) interrupt vector
+    // Set PC to (V-Blank/LCD/Timer Overflow/Serial/Joypad) interrupt vector
     PC = value;
 
-    // Reset Interrupt Master Enable flag
+    // Reset Interrupt Master Enable flag and disable halt
     IME = 0;
+    is_halted = 0;
 
-    // Clear the (V-Blank/LCD/Timer Overflow/Joypad) interrupt flag in IF
+    // Clear the (V-Blank/LCD/Timer Overflow/Serial/Joypad) interrupt flag in IF
     unset_interrupt_flag(flag);
+}
 
-    // Disable halt
-    is_halted = 0;
+auto Registers::save_state(StateWriter &out) const -> void
+{
+    out.put(PC);
+    out.put(SP);
+    out.put(IME);
+    out.put(is_halted);
+    out.put(array<u8, 8>{a, b, c, d, e, f, h, l});
+    out.put(*flags);
+}
+
+auto Registers::load_state(StateReader &in) -> void
+{
+    array<u8, 8> values = {};
+    in.get(PC);
+    in.get(SP);
+    in.get(IME);
+    in.get(is_halted);
+    in.get(values);
+    in.get(*flags);
+    a = values[0];
+    b = values[1];
+    c = values[2];
+    d = values[3];
+    e = values[4];
+    f = values[5];
+    h = values[6];
+    l = values[7];
+    update_interrupt_pending();
 }
\ No newline at end of file
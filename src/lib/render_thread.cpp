@@ -0,0 +1,79 @@
+#include "render_thread.hpp"
+#include "tracer.hpp"
+
+RenderThread::RenderThread(function<void(const LineSignature &)> render_fn)
+    : render(std::move(render_fn))
+{
+    if (!render)
+    {
+        throw runtime_error("Empty render function provided to RenderThread constructor");
+    }
+
+    worker = thread(&RenderThread::run, this);
+}
+
+RenderThread::~RenderThread()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    work_ready.notify_one();
+    worker.join();
+}
+
+auto RenderThread::push(const LineSignature &line) -> void
+{
+    {
+        // tail must never catch up with head, that reads as empty and loses every queued line
+        unique_lock<mutex> guard(lock);
+        work_done.wait(guard, [this]
+                       { return pending.load(memory_order_relaxed) < CAPACITY; });
+        pending.fetch_add(1, memory_order_relaxed);
+        queue[tail] = line;
+        tail = (tail + 1) % queue.size();
+    }
+    work_ready.notify_one();
+}
+
+auto RenderThread::drain() -> void
+{
+    if (pending.load(memory_order_acquire) == 0)
+    {
+        return;
+    }
+
+    unique_lock<mutex> guard(lock);
+    work_done.wait(guard, [this]
+                   { return pending.load(memory_order_acquire) == 0; });
+}
+
+auto RenderThread::run() -> void
+{
+    Tracer::set_thread_name("render");
+
+    unique_lock<mutex> guard(lock);
+    while (true)
+    {
+        work_ready.wait(guard, [this]
+                        { return stopping || head != tail; });
+        if (head == tail && stopping)
+        {
+            return;
+        }
+
+        LineSignature line = queue[head];
+        head = (head + 1) % queue.size();
+
+        guard.unlock();
+        render(line);
+        guard.lock();
+
+        // Wakes drain() when empty and push() when a slot frees up in a full ring
+        u16 left = pending.fetch_sub(1, memory_order_release) - 1;
+        if (left == 0 || left == CAPACITY - 1)
+        {
+            work_done.notify_all();
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#include "save_state.hpp"
+
+StateWriter::StateWriter(vector<u8> &buffer) : data(buffer)
+{
+    data.clear();
+    put(STATE_MAGIC);
+    put(STATE_VERSION);
+    put(u32{0});
+}
+
+auto StateWriter::finish() -> void
+{
+    u32 size = static_cast<u32>(data.size() - STATE_HEADER_SIZE);
+    memcpy(data.data() + 2 * sizeof(u32), &size, sizeof(size));
+}
+
+StateReader::StateReader(const vector<u8> &buffer) : data(buffer)
+{
+    if (data.size() < STATE_HEADER_SIZE)
+    {
+        throw runtime_error("Not a save state");
+    }
+
+    array<u32, 3> header = {};
+    memcpy(header.data(), data.data(), STATE_HEADER_SIZE);
+    if (header[0] != STATE_MAGIC)
+    {
+        throw runtime_error("Not a save state");
+    }
+    if (header[1] != STATE_VERSION)
+    {
+        throw runtime_error("Save state version " + to_string(header[1]) + ", expected " + to_string(STATE_VERSION));
+    }
+
+    // Every component has a fixed size, checking up front keeps a bad file from half loading
+    if (header[2] != data.size() - STATE_HEADER_SIZE)
+    {
+        throw runtime_error("Save state is truncated");
+    }
+}
+
+auto write_state_file(const string &path, const vector<u8> &state) -> void
+{
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file.is_open())
+    {
+        throw runtime_error("Failed to open save state '" + path + "'");
+    }
+    file.write(reinterpret_cast<const char *>(state.data()), static_cast<streamsize>(state.size()));
+    if (!file)
+    {
+        throw runtime_error("Failed to write save state '" + path + "'");
+    }
+}
+
+auto read_state_file(const string &path) -> vector<u8>
+{
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file.is_open())
+    {
+        throw runtime_error("Failed to open save state '" + path + "'");
+    }
+
+    vector<u8> state(static_cast<size_t>(file.tellg()));
+    file.seekg(0, ios::beg);
+    file.read(reinterpret_cast<char *>(state.data()), static_cast<streamsize>(state.size()));
+    if (!file)
+    {
+        throw runtime_error("Failed to read save state '" + path + "'");
+    }
+    return state;
+}
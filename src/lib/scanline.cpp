@@ -0,0 +1,388 @@
+#include "scanline.hpp"
+#include <cstring>
+
+#if defined(__SSE4_1__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // pshufb masks interleaving 16 r/g/b bytes into 48 bytes of RGB24
+    struct InterleaveMasks
+    {
+        alignas(16) array<array<array<u8, 16>, 3>, 3> mask = {}; // [chunk][channel]
+
+        constexpr InterleaveMasks()
+        {
+            for (u8 chunk = 0; chunk < 3; chunk++)
+            {
+                for (u8 channel = 0; channel < 3; channel++)
+                {
+                    for (u8 i = 0; i < 16; i++)
+                    {
+                        u8 byte = chunk * 16 + i;
+                        mask[chunk][channel][i] = (byte % 3 == channel) ? byte / 3 : 0x80;
+                    }
+                }
+            }
+        }
+    };
+
+    constexpr InterleaveMasks interleave;
+
+    static_assert(sizeof(Colour) == 3, "Colour must be packed RGB24");
+}
+
+auto Compositor::simd_name() -> const char *
+{
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE4_1__)
+    return "sse4.1";
+#else
+    return "scalar";
+#endif
+}
+
+auto Compositor::build_lut(u8 bgp, u8 obp0, u8 obp1) -> PaletteLUT
+{
+    PaletteLUT lut;
+    for (u8 i = 0; i < 4; i++)
+    {
+        const u8 shades[3] = {static_cast<u8>((bgp >> (i * 2)) & 3),
+                              static_cast<u8>((obp0 >> (i * 2)) & 3),
+                              static_cast<u8>((obp1 >> (i * 2)) & 3)};
+        for (u8 p = 0; p < 3; p++)
+        {
+            lut.shade[p * 4 + i] = shades[p];
+            lut.r[p * 4 + i] = MemoryBus::palette[shades[p]].r;
+            lut.g[p * 4 + i] = MemoryBus::palette[shades[p]].g;
+            lut.b[p * 4 + i] = MemoryBus::palette[shades[p]].b;
+        }
+    }
+    return lut;
+}
+
+auto BackgroundCache::refresh(MemoryBus &bus, u8 lcdc) -> void
+{
+    bool data_select = lcdc & 0x10;
+    bool full = !valid || data_select != tile_data_select;
+    if (!full && !bus.vram_dirty)
+    {
+        return;
+    }
+
+    for (u16 entry = 0; entry < 2048; entry++)
+    {
+        u16 tile = tile_index(bus.peek(0x9800 + entry), lcdc);
+        if (full || bus.dirty_map[entry] || bus.dirty_tiles[tile])
+        {
+            u8 *dst = &bitmap[entry >> 10][((entry >> 5) & 0x1F) * 8 * 256 + (entry & 0x1F) * 8];
+            for (u8 y = 0; y < 8; y++)
+            {
+                memcpy(dst + y * 256, bus.tiles[tile][y].data(), 8);
+            }
+        }
+    }
+
+    bus.dirty_tiles.reset();
+    bus.dirty_map.reset();
+    bus.vram_dirty = false;
+
+    valid = true;
+    tile_data_select = data_select;
+}
+
+auto Compositor::window_visible(const ScanlineRegs &regs) -> bool
+{
+    return (regs.lcdc & 0x20) && regs.ly >= regs.wy && regs.wx <= 166;
+}
+
+auto Compositor::blit_background(const BackgroundCache &cache, const ScanlineRegs &regs, LineBuffer &line) -> void
+{
+    // Background row wraps around the 256 pixel bitmap at most once
+    const u8 *src = cache.row((regs.lcdc & 0x08) ? 1 : 0, regs.ly + regs.scy);
+    u16 first = min<u16>(256 - regs.scx, LINE_WIDTH);
+    memcpy(&line[LINE_GUARD], src + regs.scx, first);
+    memcpy(&line[LINE_GUARD + first], src, LINE_WIDTH - first);
+
+    if (window_visible(regs))
+    {
+        const u8 *window = cache.row((regs.lcdc & 0x40) ? 1 : 0, regs.window_line);
+        i16 start = regs.wx - 7;
+        if (start < 0)
+        {
+            memcpy(&line[LINE_GUARD], window - start, LINE_WIDTH);
+        }
+        else
+        {
+            memcpy(&line[LINE_GUARD + start], window, LINE_WIDTH - start);
+        }
+    }
+}
+
+auto Compositor::expand_background(const MemoryBus &bus, const ScanlineRegs &regs, LineBuffer &line) -> void
+{
+    u8 y = regs.ly + regs.scy;
+    u16 map_offset = (regs.lcdc & 0x08 ? 0x9C00 : 0x9800) + ((y >> 3) << 5);
+    u8 column = regs.scx >> 3;
+
+    // 21 tiles cover 160 pixels plus the fine scroll
+    alignas(16) array<u8, LINE_WIDTH + 8> row;
+    for (u8 t = 0; t < 21; t++)
+    {
+        u16 tile = BackgroundCache::tile_index(bus.peek(map_offset + ((column + t) & 0x1F)), regs.lcdc);
+        memcpy(&row[t * 8], bus.tiles[tile][y & 7].data(), 8);
+    }
+
+    memcpy(&line[LINE_GUARD], &row[regs.scx & 7], LINE_WIDTH);
+
+    if (window_visible(regs))
+    {
+        u16 window_offset = (regs.lcdc & 0x40 ? 0x9C00 : 0x9800) + ((regs.window_line >> 3) << 5);
+        for (i16 x = max(regs.wx - 7, 0); x < LINE_WIDTH; x++)
+        {
+            u8 window_x = x - (regs.wx - 7);
+            u16 tile = BackgroundCache::tile_index(bus.peek(window_offset + (window_x >> 3)), regs.lcdc);
+            line[LINE_GUARD + x] = bus.tiles[tile][regs.window_line & 7][window_x & 7];
+        }
+    }
+}
+
+template <bool simd>
+auto Compositor::merge_sprites(const MemoryBus &bus, const ScanlineRegs &regs, LineBuffer &line) -> void
+{
+    if (!(regs.lcdc & 0x02)) // Sprites disabled
+    {
+        return;
+    }
+
+    u8 height = (regs.lcdc & 0x04) ? 16 : 8;
+
+    alignas(16) LineBuffer background = line;
+    alignas(16) LineBuffer claimed = {};
+
+    u8 count = 0;
+    for (u8 i = 0; i < 40 && count < MAX_SPRITES; i++)
+    {
+        Sprite sprite; // Each sprite is 4 bytes long
+        sprite.y = bus.peek(0xFE00 + i * 4);
+        sprite.x = bus.peek(0xFE01 + i * 4);
+        sprite.tile = bus.peek(0xFE02 + i * 4);
+        sprite.options.flags = bus.peek(0xFE03 + i * 4);
+
+        u8 row = regs.ly + 16 - sprite.y;
+        if (row >= height)
+        {
+            continue;
+        }
+
+        // Off-screen sprites still count towards the per-line limit
+        count++;
+        if (sprite.x == 0 || sprite.x >= LINE_WIDTH + LINE_GUARD)
+        {
+            continue;
+        }
+
+        if (sprite.options.bits.vFlip)
+        {
+            row = height - 1 - row;
+        }
+
+        u16 tile = (height == 16) ? (sprite.tile & 0xFE) + (row >> 3) : sprite.tile;
+        const u8 *pixels = bus.tiles[tile][row & 7].data();
+        u8 base = sprite.options.bits.palette ? COLOUR_ID_OBP1 : COLOUR_ID_OBP0;
+        bool behind = sprite.options.bits.render_priority;
+        bool flip = sprite.options.bits.hFlip;
+
+        // Buffer offset LINE_GUARD is screen x 0, which is sprite x 8
+        u8 pos = sprite.x;
+
+#if defined(__SSE4_1__)
+        if constexpr (simd)
+        {
+            const __m128i zero = _mm_setzero_si128();
+
+            __m128i colour = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixels));
+            if (flip)
+            {
+                colour = _mm_shuffle_epi8(colour, _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, -1, -1, -1, -1, -1, -1, -1, -1));
+            }
+
+            __m128i taken = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(&claimed[pos]));
+            __m128i draw = _mm_andnot_si128(_mm_cmpeq_epi8(colour, zero), _mm_cmpeq_epi8(taken, zero));
+            if (behind) // Only over background colour 0
+            {
+                __m128i bg = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(&background[pos]));
+                draw = _mm_and_si128(draw, _mm_cmpeq_epi8(bg, zero));
+            }
+
+            __m128i current = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(&line[pos]));
+            __m128i ids = _mm_add_epi8(colour, _mm_set1_epi8(static_cast<char>(base)));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(&line[pos]), _mm_blendv_epi8(current, ids, draw));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(&claimed[pos]), _mm_or_si128(taken, colour));
+            continue;
+        }
+#endif
+
+        for (u8 x = 0; x < 8; x++)
+        {
+            u8 colour = pixels[flip ? 7 - x : x];
+            if (colour && !claimed[pos + x] && (!behind || !background[pos + x]))
+            {
+                line[pos + x] = base + colour;
+            }
+            claimed[pos + x] |= colour;
+        }
+    }
+}
+
+template <bool simd>
+auto Compositor::map_palette(const u8 *ids, const PaletteLUT &lut, Colour *out) -> void
+{
+    u8 *dst = reinterpret_cast<u8 *>(out);
+    u8 i = 0;
+
+#if defined(__AVX2__)
+    if constexpr (simd)
+    {
+        const __m256i r_lut = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(lut.r.data())));
+        const __m256i g_lut = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(lut.g.data())));
+        const __m256i b_lut = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(lut.b.data())));
+
+        for (; i + 32 <= LINE_WIDTH; i += 32)
+        {
+            __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ids + i));
+            __m256i r = _mm256_shuffle_epi8(r_lut, index);
+            __m256i g = _mm256_shuffle_epi8(g_lut, index);
+            __m256i b = _mm256_shuffle_epi8(b_lut, index);
+
+            // Each 128-bit lane interleaves its own 16 pixels
+            __m256i chunk[3];
+            for (u8 c = 0; c < 3; c++)
+            {
+                const auto &m = interleave.mask[c];
+                chunk[c] = _mm256_or_si256(
+                    _mm256_or_si256(
+                        _mm256_shuffle_epi8(r, _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(m[0].data())))),
+                        _mm256_shuffle_epi8(g, _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(m[1].data()))))),
+                    _mm256_shuffle_epi8(b, _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(m[2].data())))));
+            }
+
+            // Lane 0 holds pixels 0-15, lane 1 pixels 16-31
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 3), _mm256_permute2x128_si256(chunk[0], chunk[1], 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 3 + 32), _mm256_permute2x128_si256(chunk[2], chunk[0], 0x30));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 3 + 64), _mm256_permute2x128_si256(chunk[1], chunk[2], 0x31));
+        }
+    }
+#elif defined(__SSE4_1__)
+    if constexpr (simd)
+    {
+        const __m128i r_lut = _mm_load_si128(reinterpret_cast<const __m128i *>(lut.r.data()));
+        const __m128i g_lut = _mm_load_si128(reinterpret_cast<const __m128i *>(lut.g.data()));
+        const __m128i b_lut = _mm_load_si128(reinterpret_cast<const __m128i *>(lut.b.data()));
+
+        for (; i + 16 <= LINE_WIDTH; i += 16)
+        {
+            __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ids + i));
+            __m128i r = _mm_shuffle_epi8(r_lut, index);
+            __m128i g = _mm_shuffle_epi8(g_lut, index);
+            __m128i b = _mm_shuffle_epi8(b_lut, index);
+
+            for (u8 c = 0; c < 3; c++)
+            {
+                const auto &m = interleave.mask[c];
+                __m128i chunk = _mm_or_si128(
+                    _mm_or_si128(
+                        _mm_shuffle_epi8(r, _mm_load_si128(reinterpret_cast<const __m128i *>(m[0].data()))),
+                        _mm_shuffle_epi8(g, _mm_load_si128(reinterpret_cast<const __m128i *>(m[1].data())))),
+                    _mm_shuffle_epi8(b, _mm_load_si128(reinterpret_cast<const __m128i *>(m[2].data()))));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 3 + c * 16), chunk);
+            }
+        }
+    }
+#endif
+
+    for (; i < LINE_WIDTH; i++)
+    {
+        u8 id = ids[i];
+        dst[i * 3 + 0] = lut.r[id];
+        dst[i * 3 + 1] = lut.g[id];
+        dst[i * 3 + 2] = lut.b[id];
+    }
+}
+
+template auto Compositor::merge_sprites<true>(const MemoryBus &, const ScanlineRegs &, LineBuffer &) -> void;
+template auto Compositor::merge_sprites<false>(const MemoryBus &, const ScanlineRegs &, LineBuffer &) -> void;
+template auto Compositor::map_palette<true>(const u8 *, const PaletteLUT &, Colour *) -> void;
+template auto Compositor::map_palette<false>(const u8 *, const PaletteLUT &, Colour *) -> void;
+
+auto Compositor::map_shades(const u8 *ids, const PaletteLUT &lut, u8 *out) -> void
+{
+    u8 i = 0;
+
+#if defined(__SSE4_1__)
+    const __m128i shade_lut = _mm_load_si128(reinterpret_cast<const __m128i *>(lut.shade.data()));
+    for (; i + 16 <= LINE_WIDTH; i += 16)
+    {
+        __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ids + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_shuffle_epi8(shade_lut, index));
+    }
+#endif
+
+    for (; i < LINE_WIDTH; i++)
+    {
+        out[i] = lut.shade[ids[i]];
+    }
+}
+
+auto Compositor::pack_shades(const u8 *shades, u8 *out) -> void
+{
+    for (u8 i = 0; i < LINE_WIDTH / 4; i++)
+    {
+        const u8 *s = shades + i * 4;
+        out[i] = s[0] | (s[1] << 2) | (s[2] << 4) | (s[3] << 6);
+    }
+}
+
+auto Compositor::unpack_shades(const u8 *packed, u8 *out) -> void
+{
+    for (u8 i = 0; i < LINE_WIDTH / 4; i++)
+    {
+        for (u8 p = 0; p < 4; p++)
+        {
+            out[i * 4 + p] = (packed[i] >> (p * 2)) & 3;
+        }
+    }
+}
+
+auto Compositor::shades_to_rgb(const u8 *shades, Colour *out) -> void
+{
+    // With BGP 0xE4 colour ids 0-3 map straight to shades 0-3
+    static const PaletteLUT identity = build_lut(0xE4, 0xE4, 0xE4);
+    map_palette<true>(shades, identity, out);
+}
+
+auto Compositor::compose(const MemoryBus &bus, const BackgroundCache &cache, const ScanlineRegs &regs, const PaletteLUT &lut, Colour *out) -> void
+{
+    alignas(16) LineBuffer line = {};
+    blit_background(cache, regs, line);
+    merge_sprites<true>(bus, regs, line);
+    map_palette<true>(&line[LINE_GUARD], lut, out);
+}
+
+auto Compositor::compose_scalar(const MemoryBus &bus, const ScanlineRegs &regs, const PaletteLUT &lut, Colour *out) -> void
+{
+    alignas(16) LineBuffer line = {};
+    expand_background(bus, regs, line);
+    merge_sprites<false>(bus, regs, line);
+    map_palette<false>(&line[LINE_GUARD], lut, out);
+}
+
+auto Compositor::compose_shades(const MemoryBus &bus, const BackgroundCache &cache, const ScanlineRegs &regs, const PaletteLUT &lut, u8 *out) -> void
+{
+    alignas(16) LineBuffer line = {};
+    blit_background(cache, regs, line);
+    merge_sprites<true>(bus, regs, line);
+    map_shades(&line[LINE_GUARD], lut, out);
+}
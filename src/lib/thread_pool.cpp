@@ -0,0 +1,88 @@
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(u8 threads)
+{
+    if (threads == 0)
+    {
+        throw runtime_error("ThreadPool needs at least one thread");
+    }
+
+    for (u8 i = 1; i < threads; i++)
+    {
+        workers.emplace_back(&ThreadPool::run_worker, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    work_ready.notify_all();
+
+    for (thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+auto ThreadPool::run(u32 count, function<void(u32)> fn) -> void
+{
+    if (workers.empty() || count <= 1)
+    {
+        for (u32 i = 0; i < count; i++)
+        {
+            fn(i);
+        }
+        return;
+    }
+
+    unique_lock<mutex> guard(lock);
+    task = std::move(fn);
+    task_count = count;
+    next_task = 0;
+    tasks_done = 0;
+    generation++;
+    work_ready.notify_all();
+
+    run_tasks(guard);
+    work_done.wait(guard, [this]
+                   { return tasks_done == task_count; });
+    task = nullptr;
+}
+
+auto ThreadPool::run_tasks(unique_lock<mutex> &guard) -> void
+{
+    while (next_task < task_count)
+    {
+        u32 index = next_task++;
+
+        guard.unlock();
+        task(index);
+        guard.lock();
+
+        if (++tasks_done == task_count)
+        {
+            work_done.notify_all();
+        }
+    }
+}
+
+auto ThreadPool::run_worker() -> void
+{
+    unique_lock<mutex> guard(lock);
+    u64 seen = 0;
+    while (true)
+    {
+        work_ready.wait(guard, [&]
+                        { return stopping || generation != seen; });
+        if (stopping)
+        {
+            return;
+        }
+
+        seen = generation;
+        run_tasks(guard);
+    }
+}
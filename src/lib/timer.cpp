@@ -0,0 +1,123 @@
+#include "timer.hpp"
+
+Timer::Timer(Registers *regs_ptr) : registers(regs_ptr)
+{
+    if (!registers)
+    {
+        throw runtime_error("Null pointer provided to Timer constructor");
+    }
+
+    div = &registers->get_bus()->get_memory(0xFF04);
+    tima = &registers->get_bus()->get_memory(0xFF05);
+    tma = &registers->get_bus()->get_memory(0xFF06);
+    tac = &registers->get_bus()->get_memory(0xFF07);
+
+    schedule();
+}
+
+auto Timer::sync(u64 now) -> void
+{
+    if (now > synced_cycle)
+    {
+        if (*tac & 0x4) // TAC bit 2 enables TIMA
+        {
+            u64 period = tima_period();
+            tick(divider(now) / period - divider(synced_cycle) / period);
+        }
+        synced_cycle = now;
+    }
+
+    *div = static_cast<u8>(divider(now) >> 8);
+    schedule();
+}
+
+auto Timer::write(u16 address, u8 value, u64 now) -> void
+{
+    sync(now);
+
+    // TIMA ticks on a falling edge of the selected divider bit, writes can cause one too
+    auto selected_bit = [&]() -> bool
+    { return (*tac & 0x4) && (divider(now) & (tima_period() >> 1)); };
+
+    switch (address)
+    {
+    case 0xFF04: // Any write resets the divider
+        if (selected_bit())
+        {
+            tick(1);
+        }
+        divider_start = now;
+        *div = 0;
+        break;
+
+    case 0xFF05:
+        *tima = value;
+        break;
+
+    case 0xFF06:
+        *tma = value;
+        break;
+
+    case 0xFF07:
+    {
+        bool before = selected_bit();
+        *tac = value | 0xF8; // Upper bits read as 1
+        if (before && !selected_bit())
+        {
+            tick(1);
+        }
+        break;
+    }
+
+    default:
+        throw runtime_error("Unknown timer register at write: 0x" + to_string(address));
+    }
+
+    schedule();
+}
+
+auto Timer::tick(u64 edges) -> void
+{
+    while (edges > 0)
+    {
+        u16 to_overflow = 256 - *tima;
+        if (edges < to_overflow)
+        {
+            *tima += static_cast<u8>(edges);
+            return;
+        }
+
+        // Overflow reloads TMA and requests the interrupt
+        edges -= to_overflow;
+        *tima = *tma;
+        registers->set_interrupt_flag(INTERRUPT_TIMER);
+    }
+}
+
+auto Timer::schedule() -> void
+{
+    if (!(*tac & 0x4))
+    {
+        deadline = ~0ull;
+        return;
+    }
+
+    // Falling edges happen where the divider crosses a multiple of the period
+    u64 period = tima_period();
+    u64 overflow = (divider(synced_cycle) / period + (256 - *tima)) * period;
+    deadline = divider_start + overflow / 4;
+}
+
+auto Timer::save_state(StateWriter &out) const -> void
+{
+    out.put(divider_start);
+    out.put(synced_cycle);
+    out.put(deadline);
+}
+
+auto Timer::load_state(StateReader &in) -> void
+{
+    in.get(divider_start);
+    in.get(synced_cycle);
+    in.get(deadline);
+}
@@ -0,0 +1,123 @@
+#include "tracer.hpp"
+#include "host_ticks.hpp"
+
+#include <iomanip>
+
+namespace
+{
+// Microseconds with ns precision, the unit of "ts" and "dur"
+auto write_us(ostream &out, u64 ns) -> void
+{
+    out << ns / 1000 << '.' << setw(3) << setfill('0') << ns % 1000 << setfill(' ');
+}
+
+auto write_string(ostream &out, const string &text) -> void
+{
+    out << '"';
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out << '\\';
+        }
+        out << c;
+    }
+    out << '"';
+}
+} // namespace
+
+auto Tracer::start() -> void
+{
+    epoch = steady_ns();
+    active.store(true, memory_order_relaxed);
+}
+
+auto Tracer::now() -> u64
+{
+    return steady_ns() - epoch;
+}
+
+auto Tracer::local_ring() -> Ring &
+{
+    thread_local Ring *ring = nullptr;
+    if (!ring)
+    {
+        // Registration is the only locked step, once per thread
+        lock_guard<mutex> guard(rings_lock);
+        rings.push_back(make_unique<Ring>());
+        ring = rings.back().get();
+        ring->tid = static_cast<u32>(rings.size());
+        ring->name = "thread " + to_string(ring->tid);
+    }
+    return *ring;
+}
+
+auto Tracer::set_thread_name(const string &name) -> void
+{
+    if (!enabled())
+    {
+        return;
+    }
+
+    Ring &ring = local_ring();
+    lock_guard<mutex> guard(rings_lock);
+    ring.name = name;
+}
+
+auto Tracer::record(const TraceEvent &event) -> void
+{
+    Ring &ring = local_ring();
+    u64 head = ring.head.load(memory_order_relaxed);
+    ring.events[head % RING_SIZE] = event;
+    ring.head.store(head + 1, memory_order_release);
+}
+
+auto Tracer::write(const string &path) -> void
+{
+    active.store(false, memory_order_relaxed);
+
+    ofstream out(path, ios::trunc);
+    if (!out.is_open())
+    {
+        throw runtime_error("Failed to open trace file '" + path + "'");
+    }
+
+    lock_guard<mutex> guard(rings_lock);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+    bool first = true;
+    auto separator = [&]() -> void
+    {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    for (const unique_ptr<Ring> &ring : rings)
+    {
+        separator();
+        out << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": " << ring->tid
+            << ", \"args\": {\"name\": ";
+        write_string(out, ring->name);
+        out << "}}";
+
+        // Oldest surviving span first
+        u64 head = ring->head.load(memory_order_acquire);
+        for (u64 i = (head > RING_SIZE) ? head - RING_SIZE : 0; i < head; i++)
+        {
+            const TraceEvent &event = ring->events[i % RING_SIZE];
+            separator();
+            out << "{\"ph\": \"X\", \"name\": \"" << event.name << "\", \"cat\": \"" << event.category
+                << "\", \"pid\": 1, \"tid\": " << ring->tid << ", \"ts\": ";
+            write_us(out, event.begin_ns);
+            out << ", \"dur\": ";
+            write_us(out, event.end_ns - event.begin_ns);
+            if (event.arg_name)
+            {
+                out << ", \"args\": {\"" << event.arg_name << "\": " << event.arg << "}";
+            }
+            out << "}";
+        }
+    }
+
+    out << "\n]}" << endl;
+}
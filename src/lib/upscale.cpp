@@ -0,0 +1,354 @@
+#include "upscale.hpp"
+#include <cstring>
+
+#if defined(__SSE4_1__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Per-pixel operations the EPX kernels are written against
+    struct ScalarOps
+    {
+        using V = u32;
+        using M = bool;
+        static constexpr u8 WIDTH = 1;
+
+        static auto load(const u32 *p) -> V { return *p; }
+        static auto eq(V a, V b) -> M { return a == b; }
+        static auto and_not(M a, M b) -> M { return !a && b; } // !a && b
+        static auto or_(M a, M b) -> M { return a || b; }
+        static auto select(M m, V a, V b) -> V { return m ? a : b; }
+
+        static auto store2(u32 *out, V a, V b) -> void
+        {
+            out[0] = a;
+            out[1] = b;
+        }
+
+        static auto store3(u32 *out, V a, V b, V c) -> void
+        {
+            out[0] = a;
+            out[1] = b;
+            out[2] = c;
+        }
+    };
+
+#if defined(__SSE4_1__)
+    struct SseOps
+    {
+        using V = __m128i;
+        using M = __m128i;
+        static constexpr u8 WIDTH = 4;
+
+        static auto load(const u32 *p) -> V { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+        static auto eq(V a, V b) -> M { return _mm_cmpeq_epi32(a, b); }
+        static auto and_not(M a, M b) -> M { return _mm_andnot_si128(a, b); }
+        static auto or_(M a, M b) -> M { return _mm_or_si128(a, b); }
+        static auto select(M m, V a, V b) -> V { return _mm_blendv_epi8(b, a, m); }
+
+        // a0 b0 a1 b1 | a2 b2 a3 b3
+        static auto store2(u32 *out, V a, V b) -> void
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi32(a, b));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4), _mm_unpackhi_epi32(a, b));
+        }
+
+        // a0 b0 c0 a1 | b1 c1 a2 b2 | c2 a3 b3 c3
+        static auto store3(u32 *out, V a, V b, V c) -> void
+        {
+            V v0 = _mm_blend_epi16(_mm_shuffle_epi32(a, _MM_SHUFFLE(1, 0, 0, 0)), _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 0, 0, 0)), 0x0C);
+            v0 = _mm_blend_epi16(v0, _mm_shuffle_epi32(c, _MM_SHUFFLE(0, 0, 0, 0)), 0x30);
+            V v1 = _mm_blend_epi16(_mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 1, 1)), _mm_shuffle_epi32(c, _MM_SHUFFLE(1, 1, 1, 1)), 0x0C);
+            v1 = _mm_blend_epi16(v1, _mm_shuffle_epi32(a, _MM_SHUFFLE(2, 2, 2, 2)), 0x30);
+            V v2 = _mm_blend_epi16(_mm_shuffle_epi32(c, _MM_SHUFFLE(3, 2, 2, 2)), _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 3, 3, 3)), 0x0C);
+            v2 = _mm_blend_epi16(v2, _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 3, 3, 3)), 0x30);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), v0);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4), v1);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8), v2);
+        }
+    };
+    using VectorOps = SseOps;
+#else
+    using VectorOps = ScalarOps;
+#endif
+
+    // c points at the first pixel of a padded row
+    template <class Ops>
+    auto scale2x_row(const u32 *c, u16 width, u16 stride, u32 *row0, u32 *row1) -> void
+    {
+        using M = typename Ops::M;
+        auto rule = [](M same, M diff1, M diff2) -> M
+        { return Ops::and_not(diff1, Ops::and_not(diff2, same)); };
+
+        for (u16 x = 0; x < width; x += Ops::WIDTH)
+        {
+            auto B = Ops::load(c + x - stride);
+            auto D = Ops::load(c + x - 1);
+            auto E = Ops::load(c + x);
+            auto F = Ops::load(c + x + 1);
+            auto H = Ops::load(c + x + stride);
+
+            Ops::store2(row0 + x * 2,
+                        Ops::select(rule(Ops::eq(D, B), Ops::eq(B, F), Ops::eq(D, H)), D, E),
+                        Ops::select(rule(Ops::eq(B, F), Ops::eq(B, D), Ops::eq(F, H)), F, E));
+            Ops::store2(row1 + x * 2,
+                        Ops::select(rule(Ops::eq(D, H), Ops::eq(D, B), Ops::eq(H, F)), D, E),
+                        Ops::select(rule(Ops::eq(H, F), Ops::eq(D, H), Ops::eq(B, F)), F, E));
+        }
+    }
+
+    template <class Ops>
+    auto scale3x_row(const u32 *c, u16 width, u16 stride, u32 *row0, u32 *row1, u32 *row2) -> void
+    {
+        using M = typename Ops::M;
+        auto rule = [](M same, M diff1, M diff2) -> M
+        { return Ops::and_not(diff1, Ops::and_not(diff2, same)); };
+
+        for (u16 x = 0; x < width; x += Ops::WIDTH)
+        {
+            auto A = Ops::load(c + x - stride - 1);
+            auto B = Ops::load(c + x - stride);
+            auto C = Ops::load(c + x - stride + 1);
+            auto D = Ops::load(c + x - 1);
+            auto E = Ops::load(c + x);
+            auto F = Ops::load(c + x + 1);
+            auto G = Ops::load(c + x + stride - 1);
+            auto H = Ops::load(c + x + stride);
+            auto I = Ops::load(c + x + stride + 1);
+
+            M top_left = rule(Ops::eq(D, B), Ops::eq(B, F), Ops::eq(D, H));
+            M top_right = rule(Ops::eq(B, F), Ops::eq(B, D), Ops::eq(F, H));
+            M bottom_left = rule(Ops::eq(D, H), Ops::eq(D, B), Ops::eq(H, F));
+            M bottom_right = rule(Ops::eq(H, F), Ops::eq(D, H), Ops::eq(B, F));
+
+            Ops::store3(row0 + x * 3,
+                        Ops::select(top_left, D, E),
+                        Ops::select(Ops::or_(Ops::and_not(Ops::eq(E, C), top_left), Ops::and_not(Ops::eq(E, A), top_right)), B, E),
+                        Ops::select(top_right, F, E));
+            Ops::store3(row1 + x * 3,
+                        Ops::select(Ops::or_(Ops::and_not(Ops::eq(E, G), top_left), Ops::and_not(Ops::eq(E, A), bottom_left)), D, E),
+                        E,
+                        Ops::select(Ops::or_(Ops::and_not(Ops::eq(E, I), top_right), Ops::and_not(Ops::eq(E, C), bottom_right)), F, E));
+            Ops::store3(row2 + x * 3,
+                        Ops::select(bottom_left, D, E),
+                        Ops::select(Ops::or_(Ops::and_not(Ops::eq(E, I), bottom_left), Ops::and_not(Ops::eq(E, G), bottom_right)), H, E),
+                        Ops::select(bottom_right, F, E));
+        }
+    }
+
+    // Repeat every pixel k times, later stores overwrite the spill of earlier ones
+    auto expand_row(const u32 *src, u16 width, u8 k, u32 *dst) -> void
+    {
+        if (k == 1)
+        {
+            memcpy(dst, src, width * sizeof(u32));
+            return;
+        }
+
+        u16 x = 0;
+#if defined(__AVX2__)
+        const int reach = (k + 7) & ~7; // Whole vectors one pixel stores
+        for (; x * k + reach <= width * k; x++)
+        {
+            __m256i v = _mm256_set1_epi32(static_cast<int>(src[x]));
+            for (u8 j = 0; j < k; j += 8)
+            {
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * k + j), v);
+            }
+        }
+#elif defined(__SSE4_1__)
+        const int reach = (k + 3) & ~3;
+        for (; x * k + reach <= width * k; x++)
+        {
+            __m128i v = _mm_set1_epi32(static_cast<int>(src[x]));
+            for (u8 j = 0; j < k; j += 4)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * k + j), v);
+            }
+        }
+#endif
+
+        // Pixels whose vector stores would spill past the row
+        for (; x < width; x++)
+        {
+            fill_n(dst + x * k, k, src[x]);
+        }
+    }
+
+    constexpr auto darken(u32 pixel) -> u32
+    {
+        return ((pixel >> 1) & 0x007F7F7F) + ((pixel >> 2) & 0x003F3F3F); // 75%
+    }
+
+    auto darken_row(u32 *row, u32 count) -> void
+    {
+        u32 x = 0;
+#if defined(__SSE4_1__)
+        const __m128i half = _mm_set1_epi32(0x007F7F7F);
+        const __m128i quarter = _mm_set1_epi32(0x003F3F3F);
+        for (; x + 4 <= count; x += 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+            v = _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(v, 1), half), _mm_and_si128(_mm_srli_epi32(v, 2), quarter));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(row + x), v);
+        }
+#endif
+        for (; x < count; x++)
+        {
+            row[x] = darken(row[x]);
+        }
+    }
+}
+
+Upscaler::Upscaler(ThreadPool *pool_ptr) : pool(pool_ptr)
+{
+    if (!pool)
+    {
+        throw runtime_error("Null pointer provided to Upscaler constructor");
+    }
+}
+
+auto Upscaler::parse_filter(const string &name) -> ScaleFilter
+{
+    if (name == "none")
+    {
+        return ScaleFilter::None;
+    }
+    if (name == "nearest")
+    {
+        return ScaleFilter::Nearest;
+    }
+    if (name == "scale2x")
+    {
+        return ScaleFilter::Scale2x;
+    }
+    if (name == "scale3x")
+    {
+        return ScaleFilter::Scale3x;
+    }
+    if (name == "lcd")
+    {
+        return ScaleFilter::LcdGrid;
+    }
+    throw runtime_error("Unknown filter: " + name + " (none, nearest, scale2x, scale3x, lcd)");
+}
+
+auto Upscaler::filter_name(ScaleFilter filter) -> const char *
+{
+    switch (filter)
+    {
+    case ScaleFilter::None:
+        return "none";
+    case ScaleFilter::Nearest:
+        return "nearest";
+    case ScaleFilter::Scale2x:
+        return "scale2x";
+    case ScaleFilter::Scale3x:
+        return "scale3x";
+    case ScaleFilter::LcdGrid:
+        return "lcd";
+    default:
+        throw runtime_error("Unknown filter at filter_name");
+    }
+}
+
+auto Upscaler::fit_factor(ScaleFilter filter, u8 max_factor) -> u8
+{
+    switch (filter)
+    {
+    case ScaleFilter::Scale2x:
+        return max<u8>(2, max_factor - max_factor % 2);
+    case ScaleFilter::Scale3x:
+        return max<u8>(3, max_factor - max_factor % 3);
+    case ScaleFilter::LcdGrid:
+        return max<u8>(2, max_factor);
+    default:
+        return max<u8>(1, max_factor);
+    }
+}
+
+auto Upscaler::load_frame(const Colour *frame) -> void
+{
+    for (u16 y = 0; y < SOURCE_HEIGHT; y++)
+    {
+        const Colour *src = frame + y * SOURCE_WIDTH;
+        u32 *dst = &padded[(y + 1) * PADDED_WIDTH + 1];
+        for (u16 x = 0; x < SOURCE_WIDTH; x++)
+        {
+            dst[x] = (src[x].r << 16) | (src[x].g << 8) | src[x].b;
+        }
+        dst[-1] = dst[0];
+        dst[SOURCE_WIDTH] = dst[SOURCE_WIDTH - 1];
+    }
+
+    memcpy(&padded[0], &padded[PADDED_WIDTH], PADDED_WIDTH * sizeof(u32));
+    memcpy(&padded[(SOURCE_HEIGHT + 1) * PADDED_WIDTH], &padded[SOURCE_HEIGHT * PADDED_WIDTH], PADDED_WIDTH * sizeof(u32));
+}
+
+auto Upscaler::scale_rows(ScaleFilter filter, u8 factor, u16 first, u16 last, u32 *out, u32 pitch) const -> void
+{
+    u8 epx = (filter == ScaleFilter::Scale2x) ? 2 : (filter == ScaleFilter::Scale3x) ? 3 : 1;
+    u8 k = factor / epx;
+    u16 stage_width = SOURCE_WIDTH * epx;
+    u32 out_width = SOURCE_WIDTH * factor;
+
+    alignas(32) array<u32, SOURCE_WIDTH * 3 * 3> stage;
+    array<const u32 *, 3> stage_rows = {&stage[0], &stage[SOURCE_WIDTH * 3], &stage[SOURCE_WIDTH * 6]};
+
+    for (u16 y = first; y < last; y++)
+    {
+        const u32 *center = &padded[(y + 1) * PADDED_WIDTH + 1];
+
+        if (epx == 2)
+        {
+            scale2x_row<VectorOps>(center, SOURCE_WIDTH, PADDED_WIDTH, &stage[0], &stage[SOURCE_WIDTH * 3]);
+        }
+        else if (epx == 3)
+        {
+            scale3x_row<VectorOps>(center, SOURCE_WIDTH, PADDED_WIDTH, &stage[0], &stage[SOURCE_WIDTH * 3], &stage[SOURCE_WIDTH * 6]);
+        }
+        else
+        {
+            stage_rows[0] = center;
+        }
+
+        for (u8 r = 0; r < epx; r++)
+        {
+            u32 *row = out + static_cast<u32>((y * epx + r) * k) * pitch;
+            expand_row(stage_rows[r], stage_width, k, row);
+
+            if (filter == ScaleFilter::LcdGrid) // Dark right column of every cell
+            {
+                for (u32 x = k - 1; x < out_width; x += k)
+                {
+                    row[x] = darken(row[x]);
+                }
+            }
+
+            for (u8 j = 1; j < k; j++)
+            {
+                memcpy(row + j * pitch, row, out_width * sizeof(u32));
+            }
+
+            if (filter == ScaleFilter::LcdGrid) // Dark bottom row of every cell
+            {
+                darken_row(row + (k - 1) * pitch, out_width);
+            }
+        }
+    }
+}
+
+auto Upscaler::run(ScaleFilter filter, u8 factor, const Colour *frame, u32 *out, u32 pitch) -> void
+{
+    if (filter == ScaleFilter::None || fit_factor(filter, factor) != factor)
+    {
+        throw runtime_error("Unsupported scale factor " + to_string(factor) + " for filter " + filter_name(filter));
+    }
+
+    load_frame(frame);
+
+    pool->run(BANDS, [&](u32 band)
+              { scale_rows(filter, factor, band * SOURCE_HEIGHT / BANDS, (band + 1) * SOURCE_HEIGHT / BANDS, out, pitch); });
+}
@@ -1,7 +1,11 @@
 #include "gameboy.hpp"
 #include "cpu.hpp"
 #include "ppu.hpp"
+#include "frame_pacer.hpp"
+#include "tracer.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <csignal>
 
 void signalHandler(int signum)
@@ -10,7 +14,27 @@ void signalHandler(int signum)
     exit(signum);
 }
 
-auto main(int /*argc*/, char * /*argv*/[]) -> int
+// Whole number in [min, 255], checked before narrowing so 300 is not taken as 44
+auto parse_u8(const string &text, int min, const string &what) -> u8
+{
+    size_t end = 0;
+    int value = -1;
+    try
+    {
+        value = stoi(text, &end);
+    }
+    catch (const logic_error &)
+    {
+        end = 0;
+    }
+    if (end == 0 || end != text.size() || value < min || value > 255)
+    {
+        throw runtime_error("Expected " + what + " between " + to_string(min) + " and 255, got: " + text);
+    }
+    return static_cast<u8>(value);
+}
+
+auto main(int argc, char *argv[]) -> int
 {
     signal(SIGINT, signalHandler);
 
@@ -19,29 +43,347 @@ auto main(int /*argc*/, char * /*argv*/[]) -> int
     FlagsRegister *flags = new FlagsRegister();
     Registers *regs = new Registers(bus, flags);
     Instruction *inst = new Instruction(regs);
-    PPU *ppu = new PPU(bus, regs);
+
+    // No window, no input and no pacing, for unattended test ROM runs
+    bool headless = find(argv + 1, argv + argc, string("--headless")) != argv + argc;
+    PPU *ppu = new PPU(bus, regs, headless);
     CPU *cpu = new CPU(regs, inst, ppu);
 
-    GameBoy gb = {RUNNING};
+    FramePacer pacer;
+    FrameProfiler profiler;
+    bool unthrottled = headless;
+    bool serial_exit = false;
+    u32 max_frames = 0; // No limit
+    bool out_of_frames = false;
+    bool frame_stats = false;
+    string trace_path;
+    string overlay_font;
+    string guest_profile_path;
+    string symbols_path;
+    u32 guest_profile_period = 1000;
+    unique_ptr<DebugPort> debug_port;
+    string state_path = "gameboy.state";
+    string initial_state_path;
+
+    // Tracing starts before any option creates a worker thread
+    char **trace_arg = find(argv + 1, argv + argc, string("--trace-json"));
+    if (trace_arg != argv + argc && trace_arg + 1 != argv + argc)
+    {
+        trace_path = trace_arg[1];
+        Tracer::start();
+        Tracer::set_thread_name("emulation");
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--frame-skip" && i + 1 < argc) // N/M: skip N of every M frames
+        {
+            string value = argv[++i];
+            size_t slash = value.find('/');
+            if (slash == string::npos)
+            {
+                throw runtime_error("Expected --frame-skip N/M, got: " + value);
+            }
+            u8 skip = parse_u8(value.substr(0, slash), 0, "--frame-skip N");
+            u8 period = parse_u8(value.substr(slash + 1), 1, "--frame-skip M");
+            ppu->set_frame_skip(skip, period);
+        }
+        else if (arg == "--render-thread") // Render scanlines on a worker thread
+        {
+            ppu->set_render_thread(true);
+        }
+        else if (arg == "--filter" && i + 1 < argc) // Upscaling filter of the presenter
+        {
+            ppu->set_filter(Upscaler::parse_filter(argv[++i]));
+        }
+        else if (arg == "--frame-format" && i + 1 < argc) // Storage of finished scanlines
+        {
+            ppu->set_frame_format(PPU::parse_frame_format(argv[++i]));
+        }
+        else if (arg == "--turbo" && i + 1 < argc) // Speed multiplier while the turbo key is held
+        {
+            pacer.set_turbo_multiplier(parse_u8(argv[++i], 1, "--turbo"));
+        }
+        else if (arg == "--unthrottled") // Run as fast as the host allows
+        {
+            unthrottled = true;
+        }
+        else if (arg == "--headless") // Already read by the find pre-pass, the PPU needs it at construction
+        {
+        }
+        else if (arg == "--rom" && i + 1 < argc) // Start a cartridge instead of the boot ROM
+        {
+            cart->load(argv[++i]);
+        }
+        else if (arg == "--serial-exit") // Stop once serial output reports Passed/Failed
+        {
+            serial_exit = true;
+        }
+        else if (arg == "--max-frames" && i + 1 < argc) // Give up after N frames, so a hung test ROM cannot stall a batch
+        {
+            max_frames = static_cast<u32>(stoul(argv[++i]));
+        }
+        else if (arg == "--trace") // Log every instruction to cpu_log.txt
+        {
+            cpu->set_trace(true);
+        }
+        else if (arg == "--trace-json" && i + 1 < argc) // Chrome trace of the host timeline, written at exit
+        {
+            i++;
+        }
+        else if (arg == "--overlay-font" && i + 1 < argc) // TTF font of the F1 performance overlay
+        {
+            overlay_font = argv[++i];
+        }
+        else if (arg == "--guest-profile" && i + 1 < argc) // Sample the guest PC, write the profile at exit
+        {
+            guest_profile_path = argv[++i];
+        }
+        else if (arg == "--profile-period" && i + 1 < argc) // M-cycles between guest PC samples
+        {
+            guest_profile_period = static_cast<u32>(stoul(argv[++i]));
+        }
+        else if (arg == "--sym" && i + 1 < argc) // RGBDS symbol file naming guest addresses
+        {
+            symbols_path = argv[++i];
+        }
+        else if (arg == "--debug-port" && i + 1 < argc) // I/O address guest code marks regions and counters on
+        {
+            debug_port = make_unique<DebugPort>(DebugPort::parse_address(argv[++i]));
+            cpu->set_debug_port(debug_port.get());
+        }
+        else if (arg == "--state" && i + 1 < argc) // File F5 saves to and F9 loads from
+        {
+            state_path = argv[++i];
+        }
+        else if (arg == "--load-state" && i + 1 < argc) // Start from a save state of the same ROM
+        {
+            initial_state_path = argv[++i];
+        }
+        else if (arg == "--frame-stats") // Host time per subsystem, percentiles every 600 frames
+        {
+            frame_stats = true;
+            cpu->set_profiler(&profiler);
+            ppu->set_profiler(&profiler);
+        }
+        else
+        {
+            throw runtime_error("Unknown argument: " + arg);
+        }
+    }
+
+    unique_ptr<GuestProfiler> guest_profiler;
+    if (!guest_profile_path.empty())
+    {
+        guest_profiler = make_unique<GuestProfiler>(guest_profile_period);
+        if (!symbols_path.empty())
+        {
+            guest_profiler->load_symbols(symbols_path);
+        }
+        cpu->set_guest_profiler(guest_profiler.get());
+    }
 
-    while (!gb.state)
+    if (overlay_font.empty())
     {
-        do
+        overlay_font = Overlay::find_font();
+    }
+    if (!headless && !overlay_font.empty())
+    {
+        ppu->enable_overlay(overlay_font);
+    }
+
+    if (cart->get_rom().empty())
+    {
+        cpu->boot();
+    }
+    else
+    {
+        cpu->start_cartridge();
+    }
+    // The M-cycle clock moves to the state's, anything timed against the old one starts over
+    auto restore_state = [&](const vector<u8> &saved) -> void
+    {
+        cpu->load_state(saved);
+        if (debug_port)
         {
-            keyboard(&gb);
-        } while (gb.state == PAUSED);
+            debug_port->restart();
+        }
+        if (Overlay *overlay = ppu->get_overlay())
+        {
+            overlay->restart_window();
+        }
+    };
+    if (!initial_state_path.empty())
+    {
+        restore_state(read_state_file(initial_state_path));
+    }
+
+    // Reused so a quick save does not allocate
+    vector<u8> state;
+    auto elapsed_us = [](chrono::steady_clock::time_point start) -> double
+    { return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count(); };
+
+    GameBoy gb = {RUNNING};
+    u32 paced_frame = ppu->get_frame_count();
+    if (frame_stats)
+    {
+        profiler.begin_frame();
+    }
+    u64 frame_begin = Tracer::now();
 
+    // Writing 0xFF to the debug port ends the run on the spot
+    while (!gb.state && !(debug_port && debug_port->is_stop_requested()))
+    {
         cpu->step();
+
+        // Input and pacing once per emulated frame
+        if (ppu->get_frame_count() != paced_frame)
+        {
+            paced_frame = ppu->get_frame_count();
+            if (frame_stats)
+            {
+                profiler.end_frame();
+            }
+            if (Tracer::enabled())
+            {
+                Tracer::record({"frame", "emulation", frame_begin, Tracer::now(), "frame", paced_frame});
+            }
+
+            if (serial_exit && cpu->get_serial().get_result() != SerialResult::None)
+            {
+                break;
+            }
+            if (max_frames && paced_frame >= max_frames)
+            {
+                out_of_frames = true;
+                break;
+            }
+
+            {
+                TraceScope input("input", "host");
+                while (!headless)
+                {
+                    keyboard(&gb, &cpu->get_joypad(), cpu->get_cycles());
+                    if (gb.state != PAUSED)
+                    {
+                        break;
+                    }
+                }
+            }
+
+            // Between frames, so nothing is half way through an instruction
+            if (gb.save_state)
+            {
+                gb.save_state = false;
+                try
+                {
+                    auto start = chrono::steady_clock::now();
+                    cpu->save_state(state);
+                    double us = elapsed_us(start);
+                    write_state_file(state_path, state);
+                    cout << "Saved state to " << state_path << " (" << state.size() << " bytes in " << us << " us)" << endl;
+                }
+                catch (const runtime_error &error)
+                {
+                    cout << "Failed to save state: " << error.what() << endl;
+                }
+            }
+            if (gb.load_state)
+            {
+                gb.load_state = false;
+                try
+                {
+                    state = read_state_file(state_path);
+                    auto start = chrono::steady_clock::now();
+                    restore_state(state);
+                    cout << "Loaded state from " << state_path << " (" << elapsed_us(start) << " us)" << endl;
+                }
+                catch (const runtime_error &error)
+                {
+                    cout << "Failed to load state: " << error.what() << endl;
+                }
+                paced_frame = ppu->get_frame_count();
+            }
+
+            PacerMode mode = unthrottled ? PacerMode::Unthrottled : gb.turbo ? PacerMode::Turbo : PacerMode::Normal;
+            if (mode != pacer.get_mode())
+            {
+                pacer.set_mode(mode);
+            }
+            {
+                TraceScope wait("pacer wait", "host");
+                pacer.wait();
+            }
+
+            if (Overlay *overlay = ppu->get_overlay())
+            {
+                overlay->set_visible(gb.overlay);
+                overlay->frame({cpu->get_cycles(), cpu->get_instructions(), cpu->get_halted_cycles(),
+                                ppu->get_frame_count(), ppu->get_skipped_frames()});
+            }
+            else if (gb.overlay)
+            {
+                cout << "No font for the overlay, pass --overlay-font PATH" << endl;
+                gb.overlay = false;
+            }
+
+            // Input handling and the pacer wait are not part of the frame
+            if (frame_stats)
+            {
+                profiler.begin_frame();
+            }
+            frame_begin = Tracer::now();
+        }
     }
 
+    if (!headless)
+    {
+        pacer.report(cout);
+    }
+    if (frame_stats)
+    {
+        profiler.report(cout);
+    }
+#ifdef OPCODE_STATS
+    cpu->get_opcode_stats().report(cout);
+#endif
+    if (guest_profiler)
+    {
+        guest_profiler->write(guest_profile_path);
+    }
+    if (debug_port)
+    {
+        debug_port->report(cout);
+    }
     ppu->quit();
 
+    // Test ROMs report over serial
+    const Serial &serial = cpu->get_serial();
+    if (!serial.get_output().empty())
+    {
+        cout << "serial output:" << endl << serial.get_output() << endl;
+    }
+    int status = (serial_exit && serial.get_result() != SerialResult::Passed) ? 1 : 0;
+    if (out_of_frames)
+    {
+        cout << "Stopped at the " << max_frames << " frame limit" << endl;
+        status = 2;
+    }
+
     delete cpu;
     delete inst;
     delete regs;
     delete flags;
     delete ppu;
     delete bus;
+    delete cart;
+
+    // Every traced thread has stopped with the PPU
+    if (!trace_path.empty())
+    {
+        Tracer::write(trace_path);
+    }
 
-    return 0;
+    return status;
 }